@@ -0,0 +1,123 @@
+// Times the AabbStore filters against their scalar versions, and checks that both keep the same slots.
+// Run it from a release build, it exits with 1 if the results ever differ
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "AabbStore.hpp"
+
+namespace
+{
+	const int BOX_COUNT = 4096;
+	const int QUERY_COUNT = 2000;
+	const float WORLD_SIZE = 4000.f;
+
+	struct Query
+	{
+		vec2 position;
+		vec2 halfBound;
+		float radius;
+	};
+
+	// Runs a filter over every query, returns the nanoseconds per box tested and the slots it kept
+	template <typename Filter>
+	double Time(const std::vector<Query>& queries, int boxesPerQuery, std::vector<int>& outSlots, Filter filter)
+	{
+		outSlots.clear();
+		const auto start = std::chrono::steady_clock::now();
+		for (const Query& query : queries)
+		{
+			filter(query, outSlots);
+		}
+		const auto end = std::chrono::steady_clock::now();
+		const double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		return nanoseconds / ((double)queries.size() * boxesPerQuery);
+	}
+
+	bool Report(const char* name, double simdTime, double scalarTime, const std::vector<int>& simdSlots, const std::vector<int>& scalarSlots)
+	{
+		const bool same = simdSlots == scalarSlots;
+		std::cout << name << ": " << simdTime << " ns/box batched, " << scalarTime << " ns/box scalar, "
+			<< scalarTime / simdTime << "x, " << simdSlots.size() << " hits" << (same ? "" : ", RESULTS DIFFER") << std::endl;
+		return same;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(0.f, WORLD_SIZE);
+	std::uniform_real_distribution<float> size(10.f, 200.f);
+	std::uniform_int_distribution<int> layer(0, 3);
+
+	AabbStore store;
+	for (int i = 0; i < BOX_COUNT; i++)
+	{
+		const int slot = store.Insert(nullptr, { coordinate(random), coordinate(random) }, { size(random), size(random) });
+		store.SetLayers(slot, AabbStore::PLAYER_SOLID << layer(random));
+	}
+
+	// Some freed slots, so that the flags matter too
+	for (int slot = 0; slot < BOX_COUNT; slot += 17)
+	{
+		store.Remove(slot);
+	}
+
+	// A shuffled slot list, the way grid cells hand them out
+	std::vector<int> slotList;
+	for (int slot = 0; slot < store.GetCapacity(); slot++)
+	{
+		slotList.push_back(slot);
+	}
+	std::shuffle(slotList.begin(), slotList.end(), random);
+
+	std::vector<Query> queries;
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		queries.push_back({ { coordinate(random), coordinate(random) }, { size(random), size(random) }, size(random) * 2 });
+	}
+
+	const uint32_t required = AabbStore::ACTIVE | AabbStore::LIGHT_OCCLUDER;
+	const uint32_t excluded = AabbStore::STATIC_OUTLINE;
+	const int capacity = store.GetCapacity();
+	const int* slots = slotList.data();
+
+	std::vector<int> simdSlots;
+	std::vector<int> scalarSlots;
+	bool same = true;
+
+	double simdTime = Time(queries, capacity, simdSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterOverlapping(nullptr, capacity, query.position, query.halfBound, required, excluded, out);
+	});
+	double scalarTime = Time(queries, capacity, scalarSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterOverlappingScalar(nullptr, capacity, query.position, query.halfBound, required, excluded, out);
+	});
+	same &= Report("overlap, every slot", simdTime, scalarTime, simdSlots, scalarSlots);
+
+	simdTime = Time(queries, capacity, simdSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterOverlapping(slots, capacity, query.position, query.halfBound, required, excluded, out);
+	});
+	scalarTime = Time(queries, capacity, scalarSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterOverlappingScalar(slots, capacity, query.position, query.halfBound, required, excluded, out);
+	});
+	same &= Report("overlap, slot list", simdTime, scalarTime, simdSlots, scalarSlots);
+
+	simdTime = Time(queries, capacity, simdSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterInRadius(nullptr, capacity, query.position, query.radius, required, excluded, out);
+	});
+	scalarTime = Time(queries, capacity, scalarSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterInRadiusScalar(nullptr, capacity, query.position, query.radius, required, excluded, out);
+	});
+	same &= Report("radius, every slot", simdTime, scalarTime, simdSlots, scalarSlots);
+
+	simdTime = Time(queries, capacity, simdSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterInRadius(slots, capacity, query.position, query.radius, required, excluded, out);
+	});
+	scalarTime = Time(queries, capacity, scalarSlots, [&](const Query& query, std::vector<int>& out) {
+		store.FilterInRadiusScalar(slots, capacity, query.position, query.radius, required, excluded, out);
+	});
+	same &= Report("radius, slot list", simdTime, scalarTime, simdSlots, scalarSlots);
+
+	return same ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Times SegmentBatch::Raycast against testing every segment with LinesCollide, the way lights used to find where a ray stops,
+// and checks that both find the same nearest hits. Run it from a release build, it exits with 1 if a hit ever differs
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "SegmentBatch.hpp"
+
+namespace
+{
+	const int SEGMENT_COUNT = 1024;
+	const int RAY_COUNT = 4000;
+	const float WORLD_SIZE = 2000.f;
+	const float TOLERANCE = 0.01f;
+
+	// Nearest hit of a ray over every segment, one LinesCollide at a time
+	bool NearestLinesCollide(const std::vector<ParametricLine>& segments, const ParametricLine& ray, vec2& outHit)
+	{
+		bool hit = false;
+		float bestDistance = INFINITY;
+		for (const ParametricLine& segment : segments)
+		{
+			vec2 collisionPos;
+			if (SegmentBatch::LinesCollide(ray, segment, collisionPos))
+			{
+				const float distance = (collisionPos - vec2({ ray.x_0, ray.y_0 })).Magnitude();
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					outHit = collisionPos;
+					hit = true;
+				}
+			}
+		}
+		return hit;
+	}
+
+	double NanosecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(-WORLD_SIZE / 2, WORLD_SIZE / 2);
+	std::uniform_real_distribution<float> length(-100.f, 100.f);
+	std::uniform_real_distribution<float> rayLength(-600.f, 600.f);
+
+	// Axis aligned like box edges, and some at an angle like rotated laser lines
+	std::vector<ParametricLine> segments;
+	SegmentBatch batch;
+	for (int i = 0; i < SEGMENT_COUNT; i++)
+	{
+		ParametricLine segment = { coordinate(random), length(random), coordinate(random), length(random) };
+		if (i % 3 == 0)
+		{
+			segment.x_t = 0.f;
+		}
+		else if (i % 3 == 1)
+		{
+			segment.y_t = 0.f;
+		}
+		segments.push_back(segment);
+		batch.Add(segment);
+	}
+
+	// Rays start at the light, which is the origin once lines are made relative to it. LinesCollide is only exact
+	// for rays starting at x = 0 or going straight up or down, which is how both lights cast them
+	std::vector<ParametricLine> rays;
+	for (int i = 0; i < RAY_COUNT; i++)
+	{
+		rays.push_back({ 0.f, rayLength(random), 0.f, rayLength(random) });
+	}
+
+	std::vector<bool> scalarHits(RAY_COUNT);
+	std::vector<vec2> scalarPoints(RAY_COUNT);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < RAY_COUNT; i++)
+	{
+		scalarHits[i] = NearestLinesCollide(segments, rays[i], scalarPoints[i]);
+	}
+	const double scalarTime = NanosecondsSince(start);
+
+	std::vector<int> batchIndices(RAY_COUNT);
+	std::vector<float> batchTimes(RAY_COUNT);
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < RAY_COUNT; i++)
+	{
+		batchIndices[i] = batch.Raycast(rays[i], 1.f, batchTimes[i]);
+	}
+	const double batchTime = NanosecondsSince(start);
+
+	int hitCount = 0;
+	int differences = 0;
+	for (int i = 0; i < RAY_COUNT; i++)
+	{
+		const bool batchHit = batchIndices[i] != -1;
+		hitCount += batchHit ? 1 : 0;
+		if (batchHit != scalarHits[i])
+		{
+			differences++;
+			continue;
+		}
+		if (batchHit)
+		{
+			const vec2 batchPoint = { rays[i].x_0 + rays[i].x_t * batchTimes[i], rays[i].y_0 + rays[i].y_t * batchTimes[i] };
+			if (std::fabs(batchPoint.x - scalarPoints[i].x) > TOLERANCE || std::fabs(batchPoint.y - scalarPoints[i].y) > TOLERANCE)
+			{
+				differences++;
+			}
+		}
+	}
+
+	const double tests = (double)RAY_COUNT * SEGMENT_COUNT;
+	std::cout << "nearest hit: " << batchTime / tests << " ns/segment batched, " << scalarTime / tests << " ns/segment LinesCollide, "
+		<< scalarTime / batchTime << "x, " << hitCount << " of " << RAY_COUNT << " rays hit";
+	if (differences != 0)
+	{
+		std::cout << ", " << differences << " HITS DIFFER";
+	}
+	std::cout << std::endl;
+
+	return differences == 0 ? 0 : 1;
+}
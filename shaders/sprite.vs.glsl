@@ -0,0 +1,26 @@
+#version 330 
+// Input attributes, per vertex of the quad
+in vec3 in_position;
+in vec2 in_texcoord;
+
+// Input attributes, per sprite
+in vec3 in_transform0;
+in vec3 in_transform1;
+in vec3 in_transform2;
+in vec4 in_color;
+
+// Passed to fragment shader
+out vec2 texcoord;
+out vec4 tint;
+
+// Application data
+uniform mat3 projection;
+
+void main()
+{
+	texcoord = in_texcoord;
+	tint = in_color;
+	mat3 transform = mat3(in_transform0, in_transform1, in_transform2);
+	vec3 pos = projection * transform * vec3(in_position.xy, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
\ No newline at end of file
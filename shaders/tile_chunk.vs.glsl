@@ -0,0 +1,20 @@
+#version 330 
+// Input attributes, already in world space
+in vec3 in_position;
+in vec2 in_texcoord;
+in vec4 in_color;
+
+// Passed to fragment shader
+out vec2 texcoord;
+out vec4 tint;
+
+// Application data
+uniform mat3 projection;
+
+void main()
+{
+	texcoord = in_texcoord;
+	tint = in_color;
+	vec3 pos = projection * vec3(in_position.xy, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include <cmath>
+#include "AabbStore.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AABB_STORE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#ifdef AABB_STORE_SSE2
+	// Loads four consecutive slots, or the four slots listed at slots[i]
+	inline __m128 Load4(const float* data, const int* slots, int i)
+	{
+		if (slots == nullptr)
+		{
+			return _mm_loadu_ps(data + i);
+		}
+		return _mm_setr_ps(data[slots[i]], data[slots[i + 1]], data[slots[i + 2]], data[slots[i + 3]]);
+	}
+
+	// Lanes whose flags have all of required and none of excluded
+	inline __m128 FlagsMask4(const uint32_t* data, const int* slots, int i, __m128i required, __m128i excluded)
+	{
+		__m128i slotFlags;
+		if (slots == nullptr)
+		{
+			slotFlags = _mm_loadu_si128((const __m128i*)(data + i));
+		}
+		else
+		{
+			slotFlags = _mm_setr_epi32((int)data[slots[i]], (int)data[slots[i + 1]], (int)data[slots[i + 2]], (int)data[slots[i + 3]]);
+		}
+
+		const __m128i hasRequired = _mm_cmpeq_epi32(_mm_and_si128(slotFlags, required), required);
+		const __m128i hasExcluded = _mm_cmpeq_epi32(_mm_and_si128(slotFlags, excluded), _mm_setzero_si128());
+		return _mm_castsi128_ps(_mm_and_si128(hasRequired, hasExcluded));
+	}
+
+	inline void AppendLanes(int laneBits, const int* slots, int i, std::vector<int>& outSlots)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (laneBits & (1 << lane))
+			{
+				outSlots.push_back(slots ? slots[i + lane] : i + lane);
+			}
+		}
+	}
+#endif
+}
+
+int AabbStore::Insert(Entity* entity, vec2 position, vec2 bound)
+{
+	int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		entities[slot] = entity;
+	}
+	else
+	{
+		slot = (int)entities.size();
+		centerX.push_back(0.f);
+		centerY.push_back(0.f);
+		halfX.push_back(0.f);
+		halfY.push_back(0.f);
+		flags.push_back(0);
+		entities.push_back(entity);
+	}
+
+	flags[slot] = ACTIVE;
+	Update(slot, position, bound);
+	return slot;
+}
+
+void AabbStore::Update(int slot, vec2 position, vec2 bound)
+{
+	centerX[slot] = position.x;
+	centerY[slot] = position.y;
+	halfX[slot] = bound.x / 2;
+	halfY[slot] = bound.y / 2;
+}
+
+void AabbStore::Remove(int slot)
+{
+	// A zero flag never matches a query, so the slot can stay in the arrays until it is reused
+	flags[slot] = 0;
+	entities[slot] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+void AabbStore::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	halfX.clear();
+	halfY.clear();
+	flags.clear();
+	entities.clear();
+	freeSlots.clear();
+}
+
+void AabbStore::SetFlag(int slot, uint32_t flag, bool set)
+{
+	if (set)
+	{
+		flags[slot] |= flag;
+	}
+	else
+	{
+		flags[slot] &= ~flag;
+	}
+}
+
+void AabbStore::SetLayers(int slot, uint32_t layers)
+{
+	flags[slot] = (flags[slot] & ~LAYERS) | (layers & LAYERS);
+}
+
+bool AabbStore::Overlaps(int slot, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags) const
+{
+	if ((flags[slot] & requiredFlags) != requiredFlags || (flags[slot] & excludedFlags) != 0)
+	{
+		return false;
+	}
+
+	return std::fabs(centerX[slot] - position.x) < halfX[slot] + halfBound.x &&
+		std::fabs(centerY[slot] - position.y) < halfY[slot] + halfBound.y;
+}
+
+bool AabbStore::InRadius(int slot, vec2 position, float radiusSqr, uint32_t requiredFlags, uint32_t excludedFlags) const
+{
+	if ((flags[slot] & requiredFlags) != requiredFlags || (flags[slot] & excludedFlags) != 0)
+	{
+		return false;
+	}
+
+	// Distance from the point to the closest point of the box
+	const float distanceX = std::fmax(0.f, std::fabs(centerX[slot] - position.x) - halfX[slot]);
+	const float distanceY = std::fmax(0.f, std::fabs(centerY[slot] - position.y) - halfY[slot]);
+	return distanceX * distanceX + distanceY * distanceY < radiusSqr;
+}
+
+void AabbStore::FilterOverlapping(const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	int i = 0;
+
+#ifdef AABB_STORE_SSE2
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 posX = _mm_set1_ps(position.x);
+	const __m128 posY = _mm_set1_ps(position.y);
+	const __m128 queryHalfX = _mm_set1_ps(halfBound.x);
+	const __m128 queryHalfY = _mm_set1_ps(halfBound.y);
+	const __m128i required = _mm_set1_epi32((int)requiredFlags);
+	const __m128i excluded = _mm_set1_epi32((int)excludedFlags);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 distanceX = _mm_and_ps(_mm_sub_ps(Load4(centerX.data(), slots, i), posX), absMask);
+		const __m128 distanceY = _mm_and_ps(_mm_sub_ps(Load4(centerY.data(), slots, i), posY), absMask);
+		const __m128 marginX = _mm_add_ps(Load4(halfX.data(), slots, i), queryHalfX);
+		const __m128 marginY = _mm_add_ps(Load4(halfY.data(), slots, i), queryHalfY);
+
+		__m128 hits = _mm_and_ps(_mm_cmplt_ps(distanceX, marginX), _mm_cmplt_ps(distanceY, marginY));
+		hits = _mm_and_ps(hits, FlagsMask4(flags.data(), slots, i, required, excluded));
+
+		const int laneBits = _mm_movemask_ps(hits);
+		if (laneBits != 0)
+		{
+			AppendLanes(laneBits, slots, i, outSlots);
+		}
+	}
+#endif
+
+	OverlappingFrom(i, slots, count, position, halfBound, requiredFlags, excludedFlags, outSlots);
+}
+
+void AabbStore::FilterInRadius(const int* slots, int count, vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	const float radiusSqr = radius * radius;
+	int i = 0;
+
+#ifdef AABB_STORE_SSE2
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 posX = _mm_set1_ps(position.x);
+	const __m128 posY = _mm_set1_ps(position.y);
+	const __m128 radiusSqr4 = _mm_set1_ps(radiusSqr);
+	const __m128i required = _mm_set1_epi32((int)requiredFlags);
+	const __m128i excluded = _mm_set1_epi32((int)excludedFlags);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 distanceX = _mm_and_ps(_mm_sub_ps(Load4(centerX.data(), slots, i), posX), absMask);
+		__m128 distanceY = _mm_and_ps(_mm_sub_ps(Load4(centerY.data(), slots, i), posY), absMask);
+		distanceX = _mm_max_ps(zero, _mm_sub_ps(distanceX, Load4(halfX.data(), slots, i)));
+		distanceY = _mm_max_ps(zero, _mm_sub_ps(distanceY, Load4(halfY.data(), slots, i)));
+		const __m128 distanceSqr = _mm_add_ps(_mm_mul_ps(distanceX, distanceX), _mm_mul_ps(distanceY, distanceY));
+
+		__m128 hits = _mm_cmplt_ps(distanceSqr, radiusSqr4);
+		hits = _mm_and_ps(hits, FlagsMask4(flags.data(), slots, i, required, excluded));
+
+		const int laneBits = _mm_movemask_ps(hits);
+		if (laneBits != 0)
+		{
+			AppendLanes(laneBits, slots, i, outSlots);
+		}
+	}
+#endif
+
+	InRadiusFrom(i, slots, count, position, radiusSqr, requiredFlags, excludedFlags, outSlots);
+}
+
+void AabbStore::FilterOverlappingScalar(const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	OverlappingFrom(0, slots, count, position, halfBound, requiredFlags, excludedFlags, outSlots);
+}
+
+void AabbStore::FilterInRadiusScalar(const int* slots, int count, vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	InRadiusFrom(0, slots, count, position, radius * radius, requiredFlags, excludedFlags, outSlots);
+}
+
+void AabbStore::OverlappingFrom(int first, const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	for (int i = first; i < count; i++)
+	{
+		const int slot = slots ? slots[i] : i;
+		if (Overlaps(slot, position, halfBound, requiredFlags, excludedFlags))
+		{
+			outSlots.push_back(slot);
+		}
+	}
+}
+
+void AabbStore::InRadiusFrom(int first, const int* slots, int count, vec2 position, float radiusSqr, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	for (int i = first; i < count; i++)
+	{
+		const int slot = slots ? slots[i] : i;
+		if (InRadius(slot, position, radiusSqr, requiredFlags, excludedFlags))
+		{
+			outSlots.push_back(slot);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "common.hpp"
+
+class Entity;
+
+// Bounding boxes of the collision entities, stored as contiguous arrays (one per component)
+// so that broad tests can check several boxes at once instead of chasing entity pointers.
+// Slots are stable until removed, freed slots are reused by later inserts.
+class AabbStore
+{
+public:
+	enum Flags : uint32_t
+	{
+		ACTIVE = 1 << 0,			// Slot holds a registered entity
+		STATIC_TILE = 1 << 1,		// Collisions against the player are resolved through the tile map
+		STATIC_OUTLINE = 1 << 6,	// Light blocking outline merged from several walls, the slot has no entity
+
+		// Collision layers, cached from the entity so that queries can filter without calling into it
+		PLAYER_SOLID = 1 << 2,		// Blocks the player and other moving boxes
+		LIGHT_OCCLUDER = 1 << 3,	// Blocks light
+		DYNAMIC_OCCLUDER = 1 << 4,	// Light blocking lines have to be recalculated every frame
+		TRIGGER = 1 << 5,			// Reacts to the player overlapping it
+		LIGHT_SENSITIVE = 1 << 7,	// Being lit changes the game, not only how it looks (e.g. a switch)
+
+		LAYERS = PLAYER_SOLID | LIGHT_OCCLUDER | DYNAMIC_OCCLUDER | TRIGGER | LIGHT_SENSITIVE,
+	};
+
+	int Insert(Entity* entity, vec2 position, vec2 bound);
+	void Update(int slot, vec2 position, vec2 bound);
+	void Remove(int slot);
+
+	// Removes every slot
+	void Clear();
+
+	void SetFlag(int slot, uint32_t flag, bool set);
+
+	// Replaces the layer flags of a slot, leaving the others untouched
+	void SetLayers(int slot, uint32_t layers);
+
+	Entity* GetEntity(int slot) const { return entities[slot]; }
+	vec2 GetPosition(int slot) const { return { centerX[slot], centerY[slot] }; }
+	vec2 GetHalfBound(int slot) const { return { halfX[slot], halfY[slot] }; }
+	uint32_t GetFlags(int slot) const { return flags[slot]; }
+
+	// Number of slots, including the free ones
+	int GetCapacity() const { return (int)entities.size(); }
+
+	// Appends the slots (taken from 'slots', or every slot when it is nullptr) whose box strictly overlaps the given box.
+	// Only slots with all of requiredFlags and none of excludedFlags are considered
+	void FilterOverlapping(const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+
+	// Same as above, keeping the slots whose box is closer than radius to the given point
+	void FilterInRadius(const int* slots, int count, vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+
+	// The two filters above one box at a time, whether SSE2 is available or not. Reference for bench_aabb
+	void FilterOverlappingScalar(const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+	void FilterInRadiusScalar(const int* slots, int count, vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+
+private:
+	// Plain per-box versions, used for the tail of a batch and where SSE2 is not available
+	bool Overlaps(int slot, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags) const;
+	bool InRadius(int slot, vec2 position, float radiusSqr, uint32_t requiredFlags, uint32_t excludedFlags) const;
+
+	// Scalar filtering of slots[first] to slots[count]
+	void OverlappingFrom(int first, const int* slots, int count, vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+	void InRadiusFrom(int first, const int* slots, int count, vec2 position, float radiusSqr, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+
+private:
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> halfX;
+	std::vector<float> halfY;
+	std::vector<uint32_t> flags;
+	std::vector<Entity*> entities;
+
+	std::vector<int> freeSlots;
+};
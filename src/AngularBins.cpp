@@ -0,0 +1,120 @@
+#include <algorithm>
+#include "AngularBins.hpp"
+
+namespace
+{
+	// Sectors are even slices of pseudo angles (see pseudo_angle), which only ever get compared
+	const float FULL_TURN = 4.f;
+	const float HALF_TURN = 2.f;
+
+	// Angle around the light, the same way RadiusLightMesh measures it (y points down)
+	float AngleOf(vec2 direction)
+	{
+		return pseudo_angle({ direction.x, -direction.y });
+	}
+}
+
+void AngularBins::Reset(int segmentCount)
+{
+	sectorCount = std::min(std::max(segmentCount / SEGMENTS_PER_SECTOR, MIN_SECTORS), MAX_SECTORS);
+	entries.clear();
+	itemCount = 0;
+}
+
+int AngularBins::SectorOf(vec2 direction) const
+{
+	const int sector = (int)(AngleOf(direction) * sectorCount / FULL_TURN);
+	return std::min(sector, sectorCount - 1);
+}
+
+void AngularBins::MarkSectors(const ParametricLine& line, SectorSet& sectors) const
+{
+	const vec2 start = { line.x_0, line.y_0 };
+	const vec2 end = { line.x_0 + line.x_t, line.y_0 + line.y_t };
+
+	// A segment covers the shorter way around between its endpoints
+	float span = AngleOf(end) - AngleOf(start);
+	if (span > HALF_TURN)
+	{
+		span -= FULL_TURN;
+	}
+	else if (span <= -HALF_TURN)
+	{
+		span += FULL_TURN;
+	}
+
+	// One touching the light, or going right through it, is in the way of rays in every direction
+	const bool throughLight = start.x * end.y - start.y * end.x == 0.f && start.x * end.x + start.y * end.y <= 0.f;
+	if (throughLight || span == HALF_TURN)
+	{
+		for (int sector = 0; sector < sectorCount; sector++)
+		{
+			sectors.set(sector);
+		}
+		return;
+	}
+
+	int sector = SectorOf(span >= 0.f ? start : end);
+	const int lastSector = SectorOf(span >= 0.f ? end : start);
+	while (true)
+	{
+		sectors.set(sector);
+		if (sector == lastSector)
+		{
+			return;
+		}
+		sector = (sector + 1) % sectorCount;
+	}
+}
+
+void AngularBins::Add(int item, const SectorSet& sectors)
+{
+	itemCount++;
+	for (int sector = 0; sector < sectorCount; sector++)
+	{
+		if (sectors.test(sector))
+		{
+			entries.push_back({ sector, item });
+		}
+	}
+}
+
+void AngularBins::Build()
+{
+	// Counting sort by sector, which keeps the items of each sector in the order they were added
+	sectorStarts.assign(sectorCount + 1, 0);
+	for (const std::pair<int, int>& entry : entries)
+	{
+		sectorStarts[entry.first + 1]++;
+	}
+
+	stats = Stats();
+	stats.sectorCount = sectorCount;
+	stats.itemCount = itemCount;
+	stats.entryCount = (int)entries.size();
+	for (int sector = 0; sector < sectorCount; sector++)
+	{
+		const int count = sectorStarts[sector + 1];
+		stats.maxEntries = std::max(stats.maxEntries, count);
+		stats.emptySectors += count == 0 ? 1 : 0;
+		sectorStarts[sector + 1] += sectorStarts[sector];
+	}
+
+	// Filling a sector moves its start to the next one's, shifted back once everything is in
+	sectorItems.resize(entries.size());
+	for (const std::pair<int, int>& entry : entries)
+	{
+		sectorItems[sectorStarts[entry.first]++] = entry.second;
+	}
+	for (int sector = sectorCount; sector > 0; sector--)
+	{
+		sectorStarts[sector] = sectorStarts[sector - 1];
+	}
+	sectorStarts[0] = 0;
+}
+
+const int* AngularBins::GetItems(int sector, int& outCount) const
+{
+	outCount = sectorStarts[sector + 1] - sectorStarts[sector];
+	return sectorItems.data() + sectorStarts[sector];
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <bitset>
+#include <vector>
+#include "common.hpp"
+
+// Splits the directions around a light into sectors and files items (segments, or entities by their boundary lines)
+// under every sector they cross, so that a ray only has to be tested against the items of its own sector.
+// The sector count follows how many segments there are, and sectors only hold item indices
+class AngularBins
+{
+public:
+	static const int MIN_SECTORS = 8;
+	static const int MAX_SECTORS = 256;
+
+	// Segments a sector should get on average, before long segments spanning several sectors
+	static const int SEGMENTS_PER_SECTOR = 4;
+
+	typedef std::bitset<MAX_SECTORS> SectorSet;
+
+	// How full the sectors of the last Build were, for tuning the numbers above
+	struct Stats
+	{
+		int sectorCount = 0;
+		int itemCount = 0;
+		int entryCount = 0;		// Items summed over every sector, itemCount if no item crossed two sectors
+		int maxEntries = 0;		// Items in the fullest sector
+		int emptySectors = 0;
+	};
+
+public:
+	// Empties every sector, and picks how many there are for that many segments
+	void Reset(int segmentCount);
+
+	int GetSectorCount() const { return sectorCount; }
+
+	// Sector of a direction relative to the light (y points down)
+	int SectorOf(vec2 direction) const;
+
+	// Sets the bits of every sector a segment relative to the light crosses
+	void MarkSectors(const ParametricLine& line, SectorSet& sectors) const;
+
+	// Files an item under every sector set in sectors. Items of a sector keep the order they were added in
+	void Add(int item, const SectorSet& sectors);
+
+	// Packs the added items by sector, has to be called before GetItems
+	void Build();
+
+	// Items of a sector, after Build
+	const int* GetItems(int sector, int& outCount) const;
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	int sectorCount = MIN_SECTORS;
+
+	// (sector, item) pairs waiting for Build
+	std::vector<std::pair<int, int>> entries;
+
+	// Items of sector s are sectorItems[sectorStarts[s]] to sectorItems[sectorStarts[s + 1]]
+	std::vector<int> sectorStarts;
+	std::vector<int> sectorItems;
+
+	int itemCount = 0;
+	Stats stats;
+};
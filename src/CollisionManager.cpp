@@ -2,9 +2,10 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <limits>
 #include "CollisionManager.hpp"
 #include "player.hpp"
-#include "movable_wall.hpp"
+#include "SegmentBatch.hpp"
 
 void CollisionManager::RegisterPlayer(Player* playerPtr)
 {
@@ -25,18 +26,378 @@ void CollisionManager::RegisterEntity(Entity* entity)
 
 	registeredEntities.insert(entity);
 
-	if (entity->is_light_collidable())
+	const int slot = InsertSlot(entity, entity->get_position(), entity->get_bounding_box());
+	entitySlots.emplace(entity, slot);
+
+	aabbs.SetLayers(slot, ComputeLayers(entity));
+	slotCells[slot] = ComputeGridCells(aabbs.GetPosition(slot), aabbs.GetHalfBound(slot));
+	InsertIntoGrid(slot, slotCells[slot]);
+
+	if (aabbs.GetFlags(slot) & AabbStore::LIGHT_OCCLUDER)
+	{
+		slotStaticSegments[slot] = occluderSegments.Insert(entity->calculate_static_equations());
+	}
+	MarkOccluderDirty(slot);
+}
+
+int CollisionManager::InsertSlot(Entity* entity, vec2 position, vec2 bound)
+{
+	const int slot = aabbs.Insert(entity, position, bound);
+	if (slot >= (int)slotCells.size())
 	{
-		staticLightCollisionLines.emplace(entity, entity->calculate_static_equations());
+		slotCells.resize(slot + 1);
+		slotVelocities.resize(slot + 1);
+		slotOccluderDirty.resize(slot + 1);
+		slotStaticSegments.resize(slot + 1, -1);
+		slotDynamicSegments.resize(slot + 1, -1);
+		slotVersions.resize(slot + 1);
 	}
+	slotVelocities[slot] = { 0.f, 0.f };
+	slotOccluderDirty[slot] = false;
+	BumpSlotVersion(slot);
+	return slot;
+}
+
+void CollisionManager::BumpSlotVersion(int slot)
+{
+	slotVersions[slot] = ++lastSlotVersion;
+	lightSnapshotDirty = true;
 }
 
 void CollisionManager::UnregisterEntity(Entity* entity)
 {
 	registeredEntities.erase(entity);
+	lightSnapshotDirty = true;
+
+	auto slotEntry = entitySlots.find(entity);
+	if (slotEntry != entitySlots.end())
+	{
+		const int slot = slotEntry->second;
+		RemoveFromGrid(slot, slotCells[slot]);
+		aabbs.Remove(slot);
+		entitySlots.erase(slotEntry);
+
+		// The slot may be reused before the next ResolveKinematicBodies
+		pendingKinematicMoves.erase(std::remove_if(pendingKinematicMoves.begin(), pendingKinematicMoves.end(),
+			[slot](const std::pair<int, vec2>& move) { return move.first == slot; }), pendingKinematicMoves.end());
+		movingKinematicSlots.erase(std::remove(movingKinematicSlots.begin(), movingKinematicSlots.end(), slot), movingKinematicSlots.end());
+		if (slotOccluderDirty[slot])
+		{
+			slotOccluderDirty[slot] = false;
+			dirtyOccluderSlots.erase(std::remove(dirtyOccluderSlots.begin(), dirtyOccluderSlots.end(), slot), dirtyOccluderSlots.end());
+		}
+
+		for (int* segments : { &slotStaticSegments[slot], &slotDynamicSegments[slot] })
+		{
+			if (*segments != -1)
+			{
+				occluderSegments.Remove(*segments);
+				*segments = -1;
+			}
+		}
+	}
+
+	auto staticTile = staticTileIndices.find(entity);
+	if (staticTile != staticTileIndices.end())
+	{
+		SetTileSolid(staticTile->second, false);
+		staticTileIndices.erase(staticTile);
+	}
+}
+
+void CollisionManager::ResetTileMap(int width, int height)
+{
+	tileMapWidth = width;
+	tileMapHeight = height;
+	solidTiles.assign(((size_t)width * height + 63) / 64, 0);
+	staticTileIndices.clear();
+	lightSnapshotDirty = true;
+
+	for (int slot : outlineSlots)
+	{
+		RemoveFromGrid(slot, slotCells[slot]);
+		aabbs.Remove(slot);
+		occluderSegments.Remove(slotStaticSegments[slot]);
+		slotStaticSegments[slot] = -1;
+	}
+	outlineSlots.clear();
+}
+
+void CollisionManager::RegisterStaticOutline(const ParametricLines& lines)
+{
+	// One slot per segment, so that a light only picks up the long segments that actually reach it
+	for (const ParametricLine& line : lines)
+	{
+		const vec2 position = { line.x_0 + line.x_t / 2, line.y_0 + line.y_t / 2 };
+		const vec2 bound = { std::fabs(line.x_t), std::fabs(line.y_t) };
+		const int slot = InsertSlot(nullptr, position, bound);
+		aabbs.SetFlag(slot, AabbStore::LIGHT_OCCLUDER | AabbStore::STATIC_OUTLINE, true);
+
+		slotCells[slot] = ComputeGridCells(aabbs.GetPosition(slot), aabbs.GetHalfBound(slot));
+		InsertIntoGrid(slot, slotCells[slot]);
+
+		slotStaticSegments[slot] = occluderSegments.Insert({ line });
+		outlineSlots.push_back(slot);
+	}
+}
+
+void CollisionManager::RegisterStaticTile(Entity* entity, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= tileMapWidth || y >= tileMapHeight)
+	{
+		return;
+	}
+
+	// The tile map assumes every tile fills exactly one block, anything else stays on the entity path
+	const vec2 position = entity->get_position();
+	const vec2 bound = entity->get_bounding_box();
+	if (position.x != x * BLOCK_SIZE || position.y != y * BLOCK_SIZE || bound.x != BLOCK_SIZE || bound.y != BLOCK_SIZE)
+	{
+		return;
+	}
+
+	auto slotEntry = entitySlots.find(entity);
+	if (slotEntry == entitySlots.end())
+	{
+		return;
+	}
+
+	const int index = y * tileMapWidth + x;
+	staticTileIndices[entity] = index;
+	SetTileSolid(index, aabbs.GetFlags(slotEntry->second) & AabbStore::PLAYER_SOLID);
+	aabbs.SetFlag(slotEntry->second, AabbStore::STATIC_TILE, true);
+}
+
+void CollisionManager::UpdateEntityCollidability(Entity* entity)
+{
+	auto slotEntry = entitySlots.find(entity);
+	if (slotEntry == entitySlots.end())
+	{
+		return;
+	}
+
+	const int slot = slotEntry->second;
+	const uint32_t layers = ComputeLayers(entity);
+	aabbs.SetLayers(slot, layers);
+	MarkOccluderDirty(slot);
+	BumpSlotVersion(slot);
+
+	// Static lines are only kept while the entity blocks light, e.g. a LightWall that was off when registered has none yet.
+	// Kept ones are taken again too, the box may have changed along with the texture
+	int& staticSegments = slotStaticSegments[slot];
+	if ((layers & AabbStore::LIGHT_OCCLUDER) && staticSegments == -1)
+	{
+		staticSegments = occluderSegments.Insert(entity->calculate_static_equations());
+	}
+	else if (layers & AabbStore::LIGHT_OCCLUDER)
+	{
+		occluderSegments.Assign(staticSegments, entity->calculate_static_equations());
+	}
+	else if (!(layers & AabbStore::LIGHT_OCCLUDER) && staticSegments != -1)
+	{
+		occluderSegments.Remove(staticSegments);
+		staticSegments = -1;
+	}
+
+	auto staticTile = staticTileIndices.find(entity);
+	if (staticTile != staticTileIndices.end())
+	{
+		SetTileSolid(staticTile->second, layers & AabbStore::PLAYER_SOLID);
+	}
+}
+
+uint32_t CollisionManager::ComputeLayers(const Entity* entity)
+{
+	uint32_t layers = 0;
+	if (entity->is_player_collidable())
+	{
+		layers |= AabbStore::PLAYER_SOLID;
+	}
+	if (entity->is_light_collidable())
+	{
+		layers |= AabbStore::LIGHT_OCCLUDER;
+	}
+	if (entity->is_light_dynamic())
+	{
+		layers |= AabbStore::DYNAMIC_OCCLUDER;
+	}
+	if (entity->is_player_trigger())
+	{
+		layers |= AabbStore::TRIGGER;
+	}
+	if (entity->activated_by_light() && entity->lit_changes_gameplay())
+	{
+		layers |= AabbStore::LIGHT_SENSITIVE;
+	}
+	return layers;
+}
+
+bool CollisionManager::IsTileSolid(int x, int y) const
+{
+	if (x < 0 || y < 0 || x >= tileMapWidth || y >= tileMapHeight)
+	{
+		return false;
+	}
+
+	const int index = y * tileMapWidth + x;
+	return (solidTiles[index >> 6] >> (index & 63)) & 1;
+}
+
+void CollisionManager::SetTileSolid(int index, bool solid)
+{
+	const uint64_t mask = 1ull << (index & 63);
+	if (solid)
+	{
+		solidTiles[index >> 6] |= mask;
+	}
+	else
+	{
+		solidTiles[index >> 6] &= ~mask;
+	}
+}
+
+void CollisionManager::UpdateEntity(Entity* entity)
+{
+	auto slotEntry = entitySlots.find(entity);
+	if (slotEntry == entitySlots.end())
+	{
+		return;
+	}
+
+	const int slot = slotEntry->second;
+	const vec2 position = entity->get_position();
+	const vec2 bound = entity->get_bounding_box();
 
-	staticLightCollisionLines.erase(entity);
-	dynamicLightCollisionLines.erase(entity);
+	// Nothing moved or resized (e.g. swapping between lit and unlit textures of the same size)
+	const vec2 previousPosition = aabbs.GetPosition(slot);
+	const vec2 previousHalfBound = aabbs.GetHalfBound(slot);
+	if (position.x == previousPosition.x && position.y == previousPosition.y && bound.x / 2 == previousHalfBound.x && bound.y / 2 == previousHalfBound.y)
+	{
+		return;
+	}
+
+	aabbs.Update(slot, position, bound);
+	MarkOccluderDirty(slot);
+	BumpSlotVersion(slot);
+
+	const GridCells cells = ComputeGridCells(aabbs.GetPosition(slot), aabbs.GetHalfBound(slot));
+	if (cells == slotCells[slot])
+	{
+		// Still within the same cells, nothing else to do
+		return;
+	}
+
+	RemoveFromGrid(slot, slotCells[slot]);
+	InsertIntoGrid(slot, cells);
+	slotCells[slot] = cells;
+}
+
+long long CollisionManager::GridKey(int x, int y)
+{
+	return ((long long)x << 32) | (unsigned int)y;
+}
+
+CollisionManager::GridCells CollisionManager::ComputeGridCells(float minX, float minY, float maxX, float maxY)
+{
+	// Bounds are inclusive so that two boxes that overlap (even by a rounding error) always share a cell
+	GridCells cells;
+	cells.minX = (int)std::floor(minX / BLOCK_SIZE);
+	cells.minY = (int)std::floor(minY / BLOCK_SIZE);
+	cells.maxX = (int)std::floor(maxX / BLOCK_SIZE);
+	cells.maxY = (int)std::floor(maxY / BLOCK_SIZE);
+	return cells;
+}
+
+CollisionManager::GridCells CollisionManager::ComputeGridCells(vec2 position, vec2 halfBound)
+{
+	return ComputeGridCells(position.x - halfBound.x, position.y - halfBound.y, position.x + halfBound.x, position.y + halfBound.y);
+}
+
+void CollisionManager::InsertIntoGrid(int slot, const GridCells& cells)
+{
+	for (int y = cells.minY; y <= cells.maxY; y++)
+	{
+		for (int x = cells.minX; x <= cells.maxX; x++)
+		{
+			entityGrid[GridKey(x, y)].push_back(slot);
+		}
+	}
+}
+
+void CollisionManager::RemoveFromGrid(int slot, const GridCells& cells)
+{
+	for (int y = cells.minY; y <= cells.maxY; y++)
+	{
+		for (int x = cells.minX; x <= cells.maxX; x++)
+		{
+			auto cell = entityGrid.find(GridKey(x, y));
+			if (cell == entityGrid.end())
+			{
+				continue;
+			}
+
+			std::vector<int>& cellSlots = cell->second;
+			cellSlots.erase(std::remove(cellSlots.begin(), cellSlots.end(), slot), cellSlots.end());
+			if (cellSlots.empty())
+			{
+				entityGrid.erase(cell);
+			}
+		}
+	}
+}
+
+bool CollisionManager::GatherGridSlots(float minX, float minY, float maxX, float maxY, std::vector<int>& outSlots) const
+{
+	const GridCells cells = ComputeGridCells(minX, minY, maxX, maxY);
+
+	// Querying more cells than there are entities is slower than just testing all of them
+	if (cells.Count() > (long long)entitySlots.size())
+	{
+		return false;
+	}
+
+	for (int y = cells.minY; y <= cells.maxY; y++)
+	{
+		for (int x = cells.minX; x <= cells.maxX; x++)
+		{
+			auto cell = entityGrid.find(GridKey(x, y));
+			if (cell != entityGrid.end())
+			{
+				outSlots.insert(outSlots.end(), cell->second.begin(), cell->second.end());
+			}
+		}
+	}
+
+	// Entities spanning several cells are found more than once
+	std::sort(outSlots.begin(), outSlots.end());
+	outSlots.erase(std::unique(outSlots.begin(), outSlots.end()), outSlots.end());
+	return true;
+}
+
+void CollisionManager::QueryOverlapping(vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	std::vector<int> candidates;
+	if (GatherGridSlots(position.x - halfBound.x, position.y - halfBound.y, position.x + halfBound.x, position.y + halfBound.y, candidates))
+	{
+		aabbs.FilterOverlapping(candidates.data(), (int)candidates.size(), position, halfBound, requiredFlags, excludedFlags, outSlots);
+	}
+	else
+	{
+		aabbs.FilterOverlapping(nullptr, aabbs.GetCapacity(), position, halfBound, requiredFlags, excludedFlags, outSlots);
+	}
+}
+
+void CollisionManager::QueryInRadius(vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const
+{
+	std::vector<int> candidates;
+	if (GatherGridSlots(position.x - radius, position.y - radius, position.x + radius, position.y + radius, candidates))
+	{
+		aabbs.FilterInRadius(candidates.data(), (int)candidates.size(), position, radius, requiredFlags, excludedFlags, outSlots);
+	}
+	else
+	{
+		aabbs.FilterInRadius(nullptr, aabbs.GetCapacity(), position, radius, requiredFlags, excludedFlags, outSlots);
+	}
 }
 
 bool CollisionManager::CollidesWithPlayer(vec2 boxPosition, vec2 boxBound, vec2 boxDisplacement, CollisionResult& outResult) const
@@ -103,100 +464,325 @@ void CollisionManager::MovePlayer(vec2 movement)
 	player->setPlayerPosition(movement);
 }
 
-const CollisionManager::CollisionResult CollisionManager::BoxTrace(int width, int height, float xPos, float yPos, float xDist, float yDist) const
+void CollisionManager::MoveKinematicBody(Entity* entity, vec2 newPosition)
 {
-	CollisionResult collisionResults;
-	collisionResults.resultXPos = xPos + xDist;
-	collisionResults.resultYPos = yPos + yDist;
+	auto slotEntry = entitySlots.find(entity);
+	if (slotEntry == entitySlots.end())
+	{
+		entity->set_position(newPosition);
+		return;
+	}
 
-	std::vector<EntityDistance> collidingEntities;
+	pendingKinematicMoves.emplace_back(slotEntry->second, newPosition - entity->get_position());
+	entity->set_position(newPosition);
+}
 
-	for (Entity* entity : registeredEntities)
+void CollisionManager::ResolveKinematicBodies()
+{
+	// Bodies that did not move since the last call are standing still
+	for (int slot : movingKinematicSlots)
 	{
-		if (!entity->is_player_collidable())
-		{
-			continue;
-		}
+		slotVelocities[slot] = { 0.f, 0.f };
+	}
+	movingKinematicSlots.clear();
 
-		// Center-to-center distance between two boxes
-		float distanceX = std::fabs(entity->get_position().x - xPos - xDist);
-		float distanceY = std::fabs(entity->get_position().y - yPos - yDist);
+	for (const std::pair<int, vec2>& move : pendingKinematicMoves)
+	{
+		const int slot = move.first;
+		const vec2 movement = move.second;
+		slotVelocities[slot] = movement;
+		movingKinematicSlots.push_back(slot);
 
-		// Margin is how much distance can be between the two centers before collision
-		float xMargin = (entity->get_bounding_box().x + width) / 2;
-		float yMargin = (entity->get_bounding_box().y + height) / 2;
+		// Bodies have already moved, check from where they were
+		const vec2 halfBound = aabbs.GetHalfBound(slot);
+		const vec2 previousPosition = aabbs.GetPosition(slot) - movement;
 
-		if (distanceX < xMargin && distanceY < yMargin)
+		CollisionResult collisionResult;
+		if (CollidesWithPlayer(previousPosition, { halfBound.x * 2, halfBound.y * 2 }, movement, collisionResult))
 		{
-			EntityDistance entDist;
-			entDist.entity = entity;
-			entDist.distanceSqr = distanceX * distanceX + distanceY * distanceY;
-			collidingEntities.push_back(entDist);
+			MovePlayer({ collisionResult.resultXPos, collisionResult.resultYPos });
 		}
 	}
+	pendingKinematicMoves.clear();
+}
+
+const CollisionManager::CollisionResult CollisionManager::BoxTrace(int width, int height, float xPos, float yPos, float xDist, float yDist) const
+{
+	vec2 boundsPosition, boundsHalf;
+	ComputeSweptBounds(width, height, xPos, yPos, xDist, yDist, boundsPosition, boundsHalf);
+
+	std::vector<int> candidates;
+	QueryOverlapping(boundsPosition, boundsHalf, AabbStore::ACTIVE | AabbStore::PLAYER_SOLID, AabbStore::STATIC_TILE, candidates);
+
+	return TraceAgainst(candidates, width, height, xPos, yPos, xDist, yDist);
+}
+
+void CollisionManager::BoxTraceBatch(const TraceRequest* requests, int count, CollisionResult* outResults) const
+{
+	const uint32_t requiredFlags = AabbStore::ACTIVE | AabbStore::PLAYER_SOLID;
+	const float infinity = std::numeric_limits<float>::infinity();
 
-	std::sort(collidingEntities.begin(), collidingEntities.end(), [](const EntityDistance ent1, const EntityDistance ent2)
+	// Everything any of the boxes covers over its move
+	float minX = infinity, minY = infinity, maxX = -infinity, maxY = -infinity;
+	long long requestCells = 0;
+	for (int i = 0; i < count; i++)
 	{
-		return ent1.distanceSqr < ent2.distanceSqr;
-	});
+		const TraceRequest& request = requests[i];
+		vec2 boundsPosition, boundsHalf;
+		ComputeSweptBounds(request.width, request.height, request.xPos, request.yPos, request.xDist, request.yDist, boundsPosition, boundsHalf);
+
+		minX = std::min(minX, boundsPosition.x - boundsHalf.x);
+		minY = std::min(minY, boundsPosition.y - boundsHalf.y);
+		maxX = std::max(maxX, boundsPosition.x + boundsHalf.x);
+		maxY = std::max(maxY, boundsPosition.y + boundsHalf.y);
+		requestCells += ComputeGridCells(boundsPosition, boundsHalf).Count();
+	}
+
+	// Boxes close to each other (e.g. a swarm) share one lookup over the area they all cover,
+	// each box then only tests that short list. Boxes spread around the level look up on their own
+	const bool shareLookup = count > 1 && ComputeGridCells(minX, minY, maxX, maxY).Count() <= requestCells;
 
-	for (struct EntityDistance colEntity : collidingEntities)
+	std::vector<int> sharedCandidates;
+	if (shareLookup)
 	{
-		Entity* entity = colEntity.entity;
-		// Center-to-center distance between two boxes
-		float distanceX = std::fabs(entity->get_position().x - xPos - xDist);
-		float distanceY = std::fabs(entity->get_position().y - yPos - yDist);
+		QueryOverlapping({ (minX + maxX) / 2, (minY + maxY) / 2 }, { (maxX - minX) / 2, (maxY - minY) / 2 }, requiredFlags, AabbStore::STATIC_TILE, sharedCandidates);
+	}
 
-		// Margin is how much distance can be between the two centers before collision
-		float xMargin = (entity->get_bounding_box().x + width) / 2;
-		float yMargin = (entity->get_bounding_box().y + height) / 2;
+	std::vector<int> candidates;
+	for (int i = 0; i < count; i++)
+	{
+		const TraceRequest& request = requests[i];
+		vec2 boundsPosition, boundsHalf;
+		ComputeSweptBounds(request.width, request.height, request.xPos, request.yPos, request.xDist, request.yDist, boundsPosition, boundsHalf);
 
-		if (distanceX < xMargin && distanceY < yMargin)
+		candidates.clear();
+		if (shareLookup)
+		{
+			aabbs.FilterOverlapping(sharedCandidates.data(), (int)sharedCandidates.size(), boundsPosition, boundsHalf, requiredFlags, AabbStore::STATIC_TILE, candidates);
+		}
+		else
 		{
-			float diffY = std::fabs(entity->get_position().y - yPos);
-			float diffX = std::fabs(entity->get_position().x - xPos);
+			QueryOverlapping(boundsPosition, boundsHalf, requiredFlags, AabbStore::STATIC_TILE, candidates);
+		}
 
-			// yPos wasn't in the margin, but after moving yDist it will be
-			if (diffY < yMargin)
-			{
-				// We know we will collide in the X axis.
-				float margin = xDist > 0 ? -xMargin : xMargin;
+		outResults[i] = TraceAgainst(candidates, request.width, request.height, request.xPos, request.yPos, request.xDist, request.yDist);
+	}
+}
+
+void CollisionManager::ComputeSweptBounds(int width, int height, float xPos, float yPos, float xDist, float yDist, vec2& outPosition, vec2& outHalfBound)
+{
+	const float SKIN = 0.01f;
+
+	const float minX = std::min(xPos, xPos + xDist) - width / 2.f;
+	const float minY = std::min(yPos, yPos + yDist) - height / 2.f;
+	const float maxX = std::max(xPos, xPos + xDist) + width / 2.f;
+	const float maxY = std::max(yPos, yPos + yDist) + height / 2.f;
 
-				collisionResults.resultXPos = entity->get_position().x + margin;
-				xDist = collisionResults.resultXPos - xPos;	
+	outPosition = { (minX + maxX) / 2, (minY + maxY) / 2 };
+	outHalfBound = { (maxX - minX) / 2 + SKIN, (maxY - minY) / 2 + SKIN };
+}
+
+const CollisionManager::CollisionResult CollisionManager::TraceAgainst(const std::vector<int>& candidates, int width, int height, float xPos, float yPos, float xDist, float yDist) const
+{
+	// Most moves end after one sweep, the others hit a wall or floor and slide along it with what is left of the move
+	const int MAX_SUB_MOVES = 4;
+
+	CollisionResult collisionResults;
+	float carriedX = 0.f;
+
+	for (int i = 0; i < MAX_SUB_MOVES && (xDist != 0.f || yDist != 0.f); i++)
+	{
+		// Sliding never leaves the area covered by the whole move, so the candidates stay valid
+		const SweepResult sweep = SweepAgainst(candidates, width, height, xPos, yPos, xDist, yDist);
+		xPos = sweep.position.x;
+		yPos = sweep.position.y;
+
+		if (sweep.timeOfImpact >= 1.f)
+		{
+			break;
+		}
+
+		// Keep moving along the surface we hit, but not into it
+		xDist = sweep.remaining.x;
+		yDist = sweep.remaining.y;
+
+		if (sweep.normal.x != 0.f)
+		{
+			xDist = 0.f;
+		}
+		else
+		{
+			if (sweep.normal.y < 0.f)
+			{
+				collisionResults.bottomCollision = true;
 			}
 			else
 			{
-				// We know we will collide in the Y axis.
-
-				MovableWall* mov_wall = dynamic_cast<MovableWall*>(entity);
-				if (mov_wall != 0) { // if the pointer isn't null then player is intersecting with a moving block and they should travel with it
-					collisionResults.resultXPos += mov_wall->get_velocity().x; // Drag the player in whatever X direction the block is moving
-					if (mov_wall->get_velocity().y > 0) {
-						// Make the player keep a similar Y velocity to the block so they will collide with it every frame and thus be dragged horizontally by it every frame
-						collisionResults.resultYPush = mov_wall->get_velocity().y; 
-					}
-				}
+				collisionResults.topCollision = true;
+			}
+			yDist = 0.f;
 
-				float margin = yDist > 0 ? -yMargin : yMargin;
-				if (yDist > 0)
-				{
-					collisionResults.bottomCollision = true;
-				}
-				else
-				{
-					collisionResults.topCollision = true;
+			if (sweep.velocity.x != 0.f || sweep.velocity.y != 0.f) { // We are touching a moving block and should travel with it
+				carriedX = sweep.velocity.x; // Drag the box in whatever X direction the block is moving
+				if (sweep.velocity.y > 0) {
+					// Make the box keep a similar Y velocity to the block so they will collide with it every frame and thus be dragged horizontally by it every frame
+					collisionResults.resultYPush = sweep.velocity.y;
 				}
-
-				collisionResults.resultYPos = entity->get_position().y + margin;
-				yDist = collisionResults.resultYPos - yPos;				
 			}
 		}
 	}
 
+	collisionResults.resultXPos = xPos + carriedX;
+	collisionResults.resultYPos = yPos;
+
 	return collisionResults;
 }
 
+const CollisionManager::SweepResult CollisionManager::SweepAgainst(const std::vector<int>& candidates, int width, int height, float xPos, float yPos, float xDist, float yDist) const
+{
+	SweepResult sweepResult;
+
+	auto sweepAgainst = [&](Entity* entity, vec2 velocity, vec2 position, vec2 bound)
+	{
+		// Margin is how much distance can be between the two centers before collision
+		float xMargin = (bound.x + width) / 2;
+		float yMargin = (bound.y + height) / 2;
+
+		float time;
+		vec2 normal;
+		if (!SweepAgainstBox(xPos, yPos, xDist, yDist, position, xMargin, yMargin, time, normal))
+		{
+			return;
+		}
+
+		// On a tie, prefer floors and ceilings so that landing on a corner still counts as landing
+		if (time < sweepResult.timeOfImpact || (time == sweepResult.timeOfImpact && normal.y != 0.f && sweepResult.normal.y == 0.f))
+		{
+			sweepResult.timeOfImpact = time;
+			sweepResult.normal = normal;
+			sweepResult.entity = entity;
+			sweepResult.velocity = velocity;
+
+			// Snap exactly against the surface on the axis we hit, so that the next sweep starts touching it rather than inside it
+			sweepResult.position.x = normal.x != 0.f ? position.x + normal.x * xMargin : xPos + xDist * time;
+			sweepResult.position.y = normal.y != 0.f ? position.y + normal.y * yMargin : yPos + yDist * time;
+		}
+	};
+
+	// Everything the box covers over the whole move
+	const float minX = std::min(xPos, xPos + xDist) - width / 2.f;
+	const float minY = std::min(yPos, yPos + yDist) - height / 2.f;
+	const float maxX = std::max(xPos, xPos + xDist) + width / 2.f;
+	const float maxY = std::max(yPos, yPos + yDist) + height / 2.f;
+
+	// Static tiles are handled below through the tile map
+	for (int slot : candidates)
+	{
+		const vec2 halfBound = aabbs.GetHalfBound(slot);
+		sweepAgainst(aabbs.GetEntity(slot), slotVelocities[slot], aabbs.GetPosition(slot), { halfBound.x * 2, halfBound.y * 2 });
+	}
+
+	// Tile (x, y) is centered on (x * BLOCK_SIZE, y * BLOCK_SIZE)
+	const float halfBlock = BLOCK_SIZE / 2.f;
+	const int minTileX = (int)std::floor((minX + halfBlock) / BLOCK_SIZE);
+	const int minTileY = (int)std::floor((minY + halfBlock) / BLOCK_SIZE);
+	const int maxTileX = (int)std::floor((maxX + halfBlock) / BLOCK_SIZE);
+	const int maxTileY = (int)std::floor((maxY + halfBlock) / BLOCK_SIZE);
+	for (int y = minTileY; y <= maxTileY; y++)
+	{
+		for (int x = minTileX; x <= maxTileX; x++)
+		{
+			if (IsTileSolid(x, y))
+			{
+				sweepAgainst(nullptr, { 0.f, 0.f }, { (float)x * BLOCK_SIZE, (float)y * BLOCK_SIZE }, { (float)BLOCK_SIZE, (float)BLOCK_SIZE });
+			}
+		}
+	}
+
+	if (sweepResult.timeOfImpact >= 1.f)
+	{
+		sweepResult.position = { xPos + xDist, yPos + yDist };
+	}
+	else
+	{
+		sweepResult.remaining = { xDist * (1.f - sweepResult.timeOfImpact), yDist * (1.f - sweepResult.timeOfImpact) };
+	}
+
+	return sweepResult;
+}
+
+bool CollisionManager::SweepAgainstBox(float xPos, float yPos, float xDist, float yDist, vec2 boxPosition, float xMargin, float yMargin, float& outTime, vec2& outNormal)
+{
+	// Overlaps shallower than this are considered touching, it absorbs rounding errors from things that push us around
+	const float SKIN = 0.01f;
+	const float infinity = std::numeric_limits<float>::infinity();
+
+	if (xDist == 0.f && yDist == 0.f)
+	{
+		return false;
+	}
+
+	// Times at which the center enters and leaves the margin on each axis
+	float xEntry, xExit, yEntry, yExit;
+	if (xDist != 0.f)
+	{
+		float nearX = xDist > 0 ? boxPosition.x - xMargin : boxPosition.x + xMargin;
+		float farX = xDist > 0 ? boxPosition.x + xMargin : boxPosition.x - xMargin;
+		xEntry = (nearX - xPos) / xDist;
+		xExit = (farX - xPos) / xDist;
+	}
+	else if (std::fabs(boxPosition.x - xPos) < xMargin)
+	{
+		xEntry = -infinity;
+		xExit = infinity;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (yDist != 0.f)
+	{
+		float nearY = yDist > 0 ? boxPosition.y - yMargin : boxPosition.y + yMargin;
+		float farY = yDist > 0 ? boxPosition.y + yMargin : boxPosition.y - yMargin;
+		yEntry = (nearY - yPos) / yDist;
+		yExit = (farY - yPos) / yDist;
+	}
+	else if (std::fabs(boxPosition.y - yPos) < yMargin)
+	{
+		yEntry = -infinity;
+		yExit = infinity;
+	}
+	else
+	{
+		return false;
+	}
+
+	const bool hitsX = xEntry > yEntry;
+	float entry = hitsX ? xEntry : yEntry;
+	const float exit = std::min(xExit, yExit);
+
+	if (entry >= exit || entry > 1.f)
+	{
+		return false;
+	}
+
+	if (entry < 0.f)
+	{
+		// Already overlapping at the start of the move
+		const float penetration = -entry * std::fabs(hitsX ? xDist : yDist);
+		if (penetration > SKIN)
+		{
+			return false;
+		}
+		entry = 0.f;
+	}
+
+	outTime = entry;
+	outNormal = hitsX ? vec2({ xDist > 0 ? -1.f : 1.f, 0.f }) : vec2({ 0.f, yDist > 0 ? -1.f : 1.f });
+	return true;
+}
+
 bool CollisionManager::BoxCollide(vec2 box1Pos, vec2 box1Bound, vec2 box2Pos, vec2 box2Bound) const {
 	// Center-to-center distance between two boxes
 	float distanceX = std::fabs(box1Pos.x - box2Pos.x);
@@ -239,135 +825,159 @@ const LaserLightMesh* CollisionManager::GetPlayerLaserLightMesh() const
     return player->getPlayerLaserLight();
 }
 
-const std::vector<Entity*> CollisionManager::GetEntitiesInRange(float xPos, float yPos, float lightRadius) const
+const std::vector<Entity*> CollisionManager::GetEntitiesInRange(float xPos, float yPos, float lightRadius, uint32_t layers) const
 {
+	std::vector<int> slots;
+	QueryInRadius({ xPos, yPos }, lightRadius, AabbStore::ACTIVE | layers, AabbStore::STATIC_OUTLINE, slots);
+
 	std::vector<Entity*> outEntities;
-	for (Entity* entity : registeredEntities)
-	{
-		const float xDiff = entity->get_position().x - xPos;
-		const float yDiff = entity->get_position().y - yPos;
-		const float xRadius = entity->get_bounding_box().x / 2;
-		const float yRadius = entity->get_bounding_box().y / 2;
-		float distanceX = fmax(0.f, std::fabs(xDiff) - xRadius);
-		float distanceY = fmax(0.f, std::fabs(yDiff) - yRadius);
-		float distanceSqr = distanceX * distanceX + distanceY * distanceY;
-		
-		if (distanceSqr < ((lightRadius)* lightRadius))
-		{
-			outEntities.push_back(entity);
-		}
+	outEntities.reserve(slots.size());
+	for (int slot : slots)
+	{
+		outEntities.push_back(aabbs.GetEntity(slot));
 	}
 
+	// Same order as walking registeredEntities
+	std::sort(outEntities.begin(), outEntities.end(), std::less<Entity*>());
 	return outEntities;
 }
 
-bool CollisionManager::LinesCollide(ParametricLine line1, ParametricLine line2) const
+void CollisionManager::GetEntitiesInBox(vec2 position, vec2 halfBound, std::vector<Entity*>& outEntities) const
 {
-	vec2 collisionPos;
-	return LinesCollide(line1, line2, collisionPos);
+	static thread_local std::vector<int> slots;
+	slots.clear();
+	QueryOverlapping(position, halfBound, AabbStore::ACTIVE, AabbStore::STATIC_OUTLINE, slots);
+
+	outEntities.clear();
+	for (int slot : slots)
+	{
+		outEntities.push_back(aabbs.GetEntity(slot));
+	}
+	std::sort(outEntities.begin(), outEntities.end(), std::less<Entity*>());
 }
 
-bool CollisionManager::LinesCollide(ParametricLine line1, ParametricLine line2, vec2& collisionPos) const
+bool CollisionManager::HasEntityInRange(vec2 position, float radius, uint32_t layers) const
 {
-	// Given
-	// line1 : x1 = a1 + b1*t1, y1 = c1 + d1*t1
-	// line2 : x2 = a2 + b2*t2, y2 = c2 + d2*t2
-	// A collision means a pair of t1 and t2 that are both 0 < t < 1
-
-	// Algebra gives:
-	// t2 = (c1 - c2 + d1*a2/b1 - d1*a1/b1) / (d2 - d1*b2/b1)
-	// t1 = (a2 + b2 * t2) / b1
-
-	// However we must consider the case where b1 == 0
-	// In that case we use the alternate equations
-	// t2 = (a1-a2)/b2
-	// t1 = (c2 - c1 + d2*t2) / d1
-
-	float epsilon = 0.0001f;
-	float a1 = line1.x_0;
-	float b1 = line1.x_t;
-	float c1 = line1.y_0;
-	float d1 = line1.y_t;
-	float a2 = line2.x_0;
-	float b2 = line2.x_t;
-	float c2 = line2.y_0;
-	float d2 = line2.y_t;
+	static thread_local std::vector<int> slots;
+	slots.clear();
+	QueryInRadius(position, radius, AabbStore::ACTIVE | layers, AabbStore::STATIC_OUTLINE, slots);
+	return !slots.empty();
+}
 
-	if (-epsilon < b1 && b1 < epsilon) // when b1 == 0
+void CollisionManager::GetPlayerTriggers(std::vector<Entity*>& outEntities) const
+{
+	outEntities.clear();
+	if (!player)
 	{
-		float t2 = (a1 - a2) / b2;
-		float t1 = (c2 - c1 + d2*t2) / d1;
+		return;
+	}
 
-		if (0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1)
-		{
-			collisionPos = { a1 + b1 * t1, c1 + d1 * t1 };
-			return true;
-		}
+	static thread_local std::vector<int> slots;
+	slots.clear();
+	QueryOverlapping(player->get_position(), { 0.f, 0.f }, AabbStore::ACTIVE | AabbStore::TRIGGER, 0, slots);
+	for (int slot : slots)
+	{
+		outEntities.push_back(aabbs.GetEntity(slot));
 	}
-	else
+}
+
+void CollisionManager::MarkOccluderDirty(int slot)
+{
+	if (!slotOccluderDirty[slot] && (aabbs.GetFlags(slot) & AabbStore::DYNAMIC_OCCLUDER))
 	{
-		float t2 = (c1 - c2 + d1 * a2 / b1 - d1 * a1 / b1) / (d2 - d1 * b2 / b1);
-		float t1 = (a2 + b2 * t2) / b1;
-		if (0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1)
-		{
-			collisionPos = { a1 + b1 * t1, c1 + d1 * t1 };
-			return true;
-		}
+		slotOccluderDirty[slot] = true;
+		dirtyOccluderSlots.push_back(slot);
 	}
+}
 
-	return false;
+uint64_t CollisionManager::GetLightInputStamp(float xPos, float yPos, float lightRadius) const
+{
+	std::vector<int> slots;
+	QueryInRadius({ xPos, yPos }, lightRadius, AabbStore::ACTIVE, 0, slots);
+	std::sort(slots.begin(), slots.end());
+
+	// FNV-1a over the versions in range. Versions are never reused, so any change above gives a different stamp
+	uint64_t stamp = 14695981039346656037ull;
+	for (int slot : slots)
+	{
+		stamp = (stamp ^ slotVersions[slot]) * 1099511628211ull;
+	}
+	return stamp;
 }
 
 void CollisionManager::UpdateDynamicLightEquations()
 {
-	dynamicLightCollisionLines.clear();
-	for (const Entity* entity : registeredEntities)
+	const uint32_t dynamicOccluder = AabbStore::ACTIVE | AabbStore::LIGHT_OCCLUDER | AabbStore::DYNAMIC_OCCLUDER;
+
+	if (!dirtyOccluderSlots.empty())
+	{
+		lightSnapshotDirty = true;
+	}
+
+	for (int slot : dirtyOccluderSlots)
 	{
-		if (entity->is_light_collidable() && entity->is_light_dynamic())
+		slotOccluderDirty[slot] = false;
+		int& segments = slotDynamicSegments[slot];
+
+		// Occluders that stopped blocking light (e.g. LightWall turned off) are dropped
+		if ((aabbs.GetFlags(slot) & dynamicOccluder) != dynamicOccluder)
 		{
-			dynamicLightCollisionLines.emplace(entity, entity->calculate_dynamic_equations());
+			if (segments != -1)
+			{
+				occluderSegments.Remove(segments);
+				segments = -1;
+			}
+			continue;
+		}
+
+		const ParametricLines lines = aabbs.GetEntity(slot)->calculate_dynamic_equations();
+		if (segments == -1)
+		{
+			segments = occluderSegments.Insert(lines);
+		}
+		else
+		{
+			occluderSegments.Assign(segments, lines);
 		}
 	}
+	dirtyOccluderSlots.clear();
 }
 
-const ParametricLines CollisionManager::CalculateLightEquations(float xPos, float yPos, float lightRadius) const
+void CollisionManager::UpdateLightSnapshot()
 {
-    ParametricLines outEquations;
-    for (std::pair<const Entity*, ParametricLines> entry : staticLightCollisionLines)
-    {
-        CalculateLightEquationForEntry(entry, outEquations, xPos, yPos, lightRadius);
-    }
-    for (std::pair<const Entity*, ParametricLines> entry : dynamicLightCollisionLines)
-    {
-        CalculateLightEquationForEntry(entry, outEquations, xPos, yPos, lightRadius);
-    }
+	// Light lines have to be up to date before they are copied
+	UpdateDynamicLightEquations();
+	if (!lightSnapshotDirty)
+	{
+		return;
+	}
+	lightSnapshotDirty = false;
 
-    return outEquations;
-}
+	lightSnapshot.Clear();
+	for (int slot = 0; slot < aabbs.GetCapacity(); slot++)
+	{
+		const uint32_t flags = aabbs.GetFlags(slot);
+		if (!(flags & AabbStore::ACTIVE))
+		{
+			continue;
+		}
 
-void CollisionManager::CalculateLightEquationForEntry(std::pair<const Entity*, ParametricLines> entry, ParametricLines& outLines, float xPos, float yPos, float lightRadius) const
-{
-    const Entity* entity = entry.first;
-    // Center-to-center distance between two boxes
-    float distanceX = fmax(0.f, std::fabs(entity->get_position().x - xPos) - entity->get_bounding_box().x / 2);
-    float distanceY = fmax(0.f, std::fabs(entity->get_position().y - yPos) - entity->get_bounding_box().y / 2);
-    float distance = sqrt(distanceX * distanceX + distanceY * distanceY);
+		lightSnapshot.Add(aabbs.GetEntity(slot), aabbs.GetPosition(slot), aabbs.GetHalfBound(slot), flags);
+		if (!(flags & AabbStore::LIGHT_OCCLUDER))
+		{
+			continue;
+		}
 
-    if (distance < lightRadius)
-    {
-        for (const ParametricLine& staticLine : entry.second)
-        {
-            // Since only position is at play, (and no scaling)
-            // We only have to do a simple translation
-            ParametricLine collEq;
-            collEq.x_0 = staticLine.x_0 - xPos;
-            collEq.x_t = staticLine.x_t;
-            collEq.y_0 = staticLine.y_0 - yPos;
-            collEq.y_t = staticLine.y_t;
-
-            outLines.push_back(collEq);
-        }
-    }
+		for (int segments : { slotStaticSegments[slot], slotDynamicSegments[slot] })
+		{
+			if (segments != -1)
+			{
+				lightSnapshot.AddOccluders(occluderSegments.GetX0(), occluderSegments.GetY0(), occluderSegments.GetDX(), occluderSegments.GetDY(),
+					occluderSegments.GetFirst(segments), occluderSegments.GetCount(segments));
+			}
+		}
+	}
+	lightSnapshot.Build();
 }
 
 bool CollisionManager::isLitByRadius(vec2 entityPos, const RadiusLightMesh* light) const
@@ -382,15 +992,31 @@ bool CollisionManager::isLitByRadius(vec2 entityPos, const RadiusLightMesh* ligh
     {
         vec2 entityToLight = lightPos - entityPos;
         ParametricLine rayTrace;
-        rayTrace.x_0 = 0.f;
+        rayTrace.x_0 = entityPos.x;
         rayTrace.x_t = entityToLight.x;
-        rayTrace.y_0 = 0.f;
+        rayTrace.y_0 = entityPos.y;
         rayTrace.y_t = entityToLight.y;
 
-        const ParametricLines blockingEquations = CalculateLightEquations(entityPos.x, entityPos.y, light->getLightRadius());
-        for (const ParametricLine& blockingLine : blockingEquations)
+        // Light blocking lines around us, straight from the snapshot that every light reads too.
+        // Items are reused from one call to the next so that lit queries do not allocate
+        static thread_local std::vector<int> items;
+        items.clear();
+        lightSnapshot.QueryInRadius(entityPos, light->getLightRadius(), AabbStore::ACTIVE | AabbStore::LIGHT_OCCLUDER, 0, items);
+
+        // Lines of consecutive items are next to each other in the snapshot, and are tested as one run
+        size_t itemIndex = 0;
+        while (itemIndex < items.size())
         {
-            if (LinesCollide(rayTrace, blockingLine))
+            const int first = lightSnapshot.GetItem(items[itemIndex]).firstOccluder;
+            int last = first + lightSnapshot.GetItem(items[itemIndex]).occluderCount;
+            for (itemIndex++; itemIndex < items.size() && lightSnapshot.GetItem(items[itemIndex]).firstOccluder == last; itemIndex++)
+            {
+                last += lightSnapshot.GetItem(items[itemIndex]).occluderCount;
+            }
+
+            float hitTime;
+            if (last > first && SegmentBatch::Raycast(rayTrace, 1.f, lightSnapshot.GetOccluderX0(), lightSnapshot.GetOccluderY0(),
+                lightSnapshot.GetOccluderDX(), lightSnapshot.GetOccluderDY(), first, last, hitTime) != -1)
             {
                 return false;
             }
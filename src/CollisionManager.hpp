@@ -1,9 +1,13 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
 #include <set>
+#include <unordered_map>
 #include "entity.hpp"
 #include "common.hpp"
+#include "AabbStore.hpp"
+#include "SegmentArena.hpp"
+#include "LightSnapshot.hpp"
 
 // Manages collisions
 class CollisionManager
@@ -11,14 +15,19 @@ class CollisionManager
 
 public:
 
-struct EntityDistance
+// SweepResult is the result of sweeping one box along a displacement until it first touches something
+struct SweepResult
 {
-	Entity* entity;
-	float distanceSqr;
+	float timeOfImpact = 1.f;				// Fraction of the displacement travelled before the first contact, 1 if nothing was hit
+	vec2 position = { 0.f, 0.f };			// Where the box stops, exactly touching what it hit
+	vec2 normal = { 0.f, 0.f };				// Normal of the surface that was hit, zero if nothing was hit
+	vec2 remaining = { 0.f, 0.f };			// Displacement left over after the contact
+	Entity* entity = nullptr;				// Entity that was hit. nullptr for static tiles or if nothing was hit
+	vec2 velocity = { 0.f, 0.f };			// How far the entity that was hit moved this frame, non-zero for moving kinematic bodies
 };
 
 // CollisionResult is the result of moving one box a set distance.
-// Collisions are resolved one by one
+// The box is swept and slides along whatever it hits
 struct CollisionResult
 {
 	float resultXPos = 0.f;					// Final position the box would be
@@ -28,6 +37,17 @@ struct CollisionResult
 	float resultYPush = 0.f;
 };
 
+// TraceRequest is one box to move with BoxTraceBatch
+struct TraceRequest
+{
+	int width = 0;
+	int height = 0;
+	float xPos = 0.f;
+	float yPos = 0.f;
+	float xDist = 0.f;
+	float yDist = 0.f;
+};
+
 public:
 	CollisionManager() {}
 
@@ -48,6 +68,22 @@ public:
 	// Unregisters an entity. Should be called on destroy.
 	void UnregisterEntity(Entity* entity);
 
+	// Refreshes the spatial grid for an entity. Should be called whenever its position or bounding box changes
+	void UpdateEntity(Entity* entity);
+
+	// Clears the static tile map and resizes it for a level of the given size (in tiles). Should be called before a level is built
+	void ResetTileMap(int width, int height);
+
+	// Registers an already registered entity as the static tile at (x, y). Its collisions are then resolved through the tile map
+	void RegisterStaticTile(Entity* entity, int x, int y);
+
+	// Registers light blocking segments that belong to no entity, e.g. wall outlines merged at level load.
+	// They are cleared by the next ResetTileMap
+	void RegisterStaticOutline(const ParametricLines& lines);
+
+	// Refreshes an entity's cached collision layers. Should be called whenever its collidability changes (e.g. LightWall being lit)
+	void UpdateEntityCollidability(Entity* entity);
+
 	// Registers the player
 	void RegisterPlayer(Player* playerPtr);
 	void UnregisterPlayer();
@@ -56,41 +92,165 @@ public:
 
 	void MovePlayer(vec2 movement);
 
+	// Moves a kinematic body (e.g. MovableWall) to a new position.
+	// Whatever it pushes or carries is resolved later, in ResolveKinematicBodies
+	void MoveKinematicBody(Entity* entity, vec2 newPosition);
+
+	// Pushes the player out of the way of every kinematic body moved since the last call, and keeps how far
+	// each of them moved so that boxes standing on them are carried along by BoxTrace. Should be called once per frame, after entities update
+	void ResolveKinematicBodies();
+
 	// Given a box with param dimensions moving a distance of xDist, yDist
 	// Return the result of all collisions that will happen
 	const CollisionResult BoxTrace(int width, int height, float xPos, float yPos, float xDist, float yDist) const;
 
+	// Same as calling BoxTrace for each request, but the broadphase lookup is shared by all of them.
+	// outResults[i] is the result of requests[i]
+	void BoxTraceBatch(const TraceRequest* requests, int count, CollisionResult* outResults) const;
+
 	// Check whether door and player are colliding
 	// Return true if they are
 	bool BoxCollide(vec2 box1Pos, vec2 box1Bound, vec2 box2Pos, vec2 box2Bound) const;
 
 	bool BoxCollideWithPlayer(vec2 boxPos, vec2 boxBound) const;
 
-	// Returns a list of all the vertices of light-blocking objects that are found within a light's radius
-	const std::vector<Entity*> GetEntitiesInRange(float xPos, float yPos, float lightRadius) const;
+	// Returns a list of all the entities found within a light's radius.
+	// layers (AabbStore::Flags) restricts it to the entities on all of the given layers
+	const std::vector<Entity*> GetEntitiesInRange(float xPos, float yPos, float lightRadius, uint32_t layers = 0) const;
+
+	// Entities whose bounding box overlaps the given box, sorted by address so that they can be binary searched
+	void GetEntitiesInBox(vec2 position, vec2 halfBound, std::vector<Entity*>& outEntities) const;
+
+	// Whether any entity on all of the given layers (AabbStore::Flags) is within radius of a point
+	bool HasEntityInRange(vec2 position, float radius, uint32_t layers) const;
+
+	// Triggers (e.g. doors) whose box holds the player's center
+	void GetPlayerTriggers(std::vector<Entity*>& outEntities) const;
+
+	// Stamp of everything registered within range of a light: it changes whenever one of them is registered, unregistered,
+	// moves, resizes or changes collision layers, or when something enters or leaves the range. Lets lights skip rebuilding unchanged polygons
+	uint64_t GetLightInputStamp(float xPos, float yPos, float lightRadius) const;
 
+	// Recalculates the light collision lines of the dynamic occluders that moved or changed since the last call
 	void UpdateDynamicLightEquations();
 
-	bool LinesCollide(ParametricLine line1, ParametricLine line2) const;
-	bool LinesCollide(ParametricLine line1, ParametricLine line2, vec2& collisionPos) const;
+	// Rebuilds the light snapshot if anything was registered, moved or changed since it was last built.
+	// Should be called once per frame after UpdateDynamicLightEquations, and before lights are computed
+	void UpdateLightSnapshot();
+
+	// What lights and isLitByRadius read from, as of the last UpdateLightSnapshot
+	const LightSnapshot& GetLightSnapshot() const { return lightSnapshot; }
 
 	std::set<Entity*> GetEntities() const { return registeredEntities; };
 
+	// Whether the entity has a box here. Some (e.g. a Firefly swarm) never register and are in no query
+	bool IsRegistered(const Entity* entity) const { return entitySlots.find(entity) != entitySlots.end(); }
+
 	const RadiusLightMesh* GetPlayerRadiusLightMesh() const;
 	const LaserLightMesh* GetPlayerLaserLightMesh() const;
 
     bool isLitByRadius(vec2 entityPos, const RadiusLightMesh* light) const;
 
-    const ParametricLines CalculateLightEquations(float xPos, float yPos, float lightRadius) const;
-    void CalculateLightEquationForEntry(std::pair<const Entity*, ParametricLines> entry, ParametricLines& outLines, float xPos, float yPos, float lightRadius) const;
 
+private:
+	// Range of grid cells (inclusive) that an entity's bounding box overlaps
+	struct GridCells
+	{
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+
+		bool operator==(const GridCells& other) const
+		{
+			return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+		}
+
+		long long Count() const
+		{
+			return (long long)(maxX - minX + 1) * (maxY - minY + 1);
+		}
+	};
+
+	// Box covering everything a box touches over a move, grown a little so that
+	// boxes we are touching within SweepAgainstBox's tolerance are not missed
+	static void ComputeSweptBounds(int width, int height, float xPos, float yPos, float xDist, float yDist, vec2& outPosition, vec2& outHalfBound);
+
+	// BoxTrace against already gathered candidate slots (see ComputeSweptBounds) and the tile map, and the single sweep
+	// it is made of: where the box first touches something. Boxes it already overlaps are ignored so it can always move out of them
+	const CollisionResult TraceAgainst(const std::vector<int>& candidates, int width, int height, float xPos, float yPos, float xDist, float yDist) const;
+	const SweepResult SweepAgainst(const std::vector<int>& candidates, int width, int height, float xPos, float yPos, float xDist, float yDist) const;
+
+	// Sweeps the center of a box against another box whose margins were already grown by the moving box's half size
+	static bool SweepAgainstBox(float xPos, float yPos, float xDist, float yDist, vec2 boxPosition, float xMargin, float yMargin, float& outTime, vec2& outNormal);
+
+	static long long GridKey(int x, int y);
+	static GridCells ComputeGridCells(float minX, float minY, float maxX, float maxY);
+	static GridCells ComputeGridCells(vec2 position, vec2 halfBound);
+
+	// Stores a box in a new slot and resets the per-slot data that goes with it
+	int InsertSlot(Entity* entity, vec2 position, vec2 bound);
+
+	// Gives the slot a new version, for GetLightInputStamp
+	void BumpSlotVersion(int slot);
+
+	// Asks the entity which collision layers it is on. Only called on register and when notified of a change
+	static uint32_t ComputeLayers(const Entity* entity);
+
+	bool IsTileSolid(int x, int y) const;
+	void SetTileSolid(int index, bool solid);
+
+	void InsertIntoGrid(int slot, const GridCells& cells);
+	void RemoveFromGrid(int slot, const GridCells& cells);
+
+	// Collects the unique slots whose cells overlap the given area.
+	// Returns false when the area covers so many cells that every slot should be tested instead
+	bool GatherGridSlots(float minX, float minY, float maxX, float maxY, std::vector<int>& outSlots) const;
+
+	// Broadphase queries: grid lookup, then a batched test against the boxes in the AabbStore
+	void QueryOverlapping(vec2 position, vec2 halfBound, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
+	void QueryInRadius(vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outSlots) const;
 
 private:
 	std::set<Entity*> registeredEntities;
 
-	// Game entities : Light collision equations
-	std::map<const Entity*, const ParametricLines> staticLightCollisionLines;
-	std::map<const Entity*, const ParametricLines> dynamicLightCollisionLines;
+	// Bounding boxes of the registered entities, indexed by slot
+	AabbStore aabbs;
+	std::unordered_map<const Entity*, int> entitySlots;
+
+	// Broadphase: uniform grid of BLOCK_SIZE cells, each holding the slots of the entities that overlap it
+	std::unordered_map<long long, std::vector<int>> entityGrid;
+	std::vector<GridCells> slotCells;
+
+	// Kinematic bodies: how far each slot moved this frame
+	std::vector<vec2> slotVelocities;
+	std::vector<std::pair<int, vec2>> pendingKinematicMoves;
+	std::vector<int> movingKinematicSlots;
+
+	// Version of each slot, taken from a single counter so that no two changes ever share a version
+	std::vector<uint64_t> slotVersions;
+	uint64_t lastSlotVersion = 0;
+
+	// Dynamic light occluders whose lines have to be recalculated
+	void MarkOccluderDirty(int slot);
+	std::vector<int> dirtyOccluderSlots;
+	std::vector<bool> slotOccluderDirty;
+
+	// Static tiles (walls, glass...): one bit per level tile, set when the tile is player collidable
+	std::vector<uint64_t> solidTiles;
+	int tileMapWidth = 0;
+	int tileMapHeight = 0;
+	std::unordered_map<const Entity*, int> staticTileIndices;
+
+	// Game entities : Light collision segments, -1 if the slot has none
+	SegmentArena occluderSegments;
+	std::vector<int> slotStaticSegments;
+	std::vector<int> slotDynamicSegments;
+	std::vector<int> outlineSlots;
+
+	// Copy of the boxes and light lines above for lights, rebuilt by UpdateLightSnapshot when dirty
+	LightSnapshot lightSnapshot;
+	bool lightSnapshotDirty = true;
 	
 	// Ptr to player, we can keep our position this way. Const as we should never change it.
 	Player* player;
@@ -12,6 +12,7 @@ void DarkWall::deactivate()
 	{
 		isCollidable = true;
 	}
+	CollisionManager::GetInstance().UpdateEntityCollidability(this);
 }
 
 void DarkWall::activate()
@@ -19,6 +20,7 @@ void DarkWall::activate()
 	set_lit(true);
 	isCollidable = false;
 	shouldBeCollidable = false;
+	CollisionManager::GetInstance().UpdateEntityCollidability(this);
 }
 
 void DarkWall::update(float ms)
@@ -29,6 +31,7 @@ void DarkWall::update(float ms)
 		{
 			isCollidable = true;
 			shouldBeCollidable = false;
+			CollisionManager::GetInstance().UpdateEntityCollidability(this);
 		}
 	}
 }
\ No newline at end of file
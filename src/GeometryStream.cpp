@@ -0,0 +1,185 @@
+#include <cstring>
+#include <algorithm>
+#include "GeometryStream.hpp"
+
+namespace
+{
+	// Keeps vertex attributes and indices aligned, whichever gets written first
+	const size_t ALIGNMENT = 16;
+}
+
+bool GeometryStream::Init()
+{
+	persistent = HasBufferStorage();
+	CreateBuffer();
+	return !gl_has_errors();
+}
+
+void GeometryStream::Destroy()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence != nullptr)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	// Deleting a buffer unmaps it
+	glDeleteBuffers(1, &buffer);
+	glDeleteBuffers((GLsizei)retiredBuffers.size(), retiredBuffers.data());
+	retiredBuffers.clear();
+	buffer = 0;
+	mapped = nullptr;
+}
+
+void GeometryStream::BeginFrame()
+{
+	// Their last draws were issued last frame, GL keeps their storage alive for as long as it needs it
+	if (!retiredBuffers.empty())
+	{
+		glDeleteBuffers((GLsizei)retiredBuffers.size(), retiredBuffers.data());
+		retiredBuffers.clear();
+	}
+
+	frame = (frame + 1) % FRAMES_IN_FLIGHT;
+
+	if (persistent)
+	{
+		// Wait until the GPU is done with what we wrote here FRAMES_IN_FLIGHT frames ago
+		GLsync& fence = fences[frame];
+		if (fence != nullptr)
+		{
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED)
+			{
+				flags = 0;
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		head = frame * regionSize;
+		end = head + regionSize;
+	}
+	else
+	{
+		// Fresh storage for this frame, the driver keeps the old one until it has been drawn
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+		head = 0;
+		end = regionSize;
+	}
+}
+
+void GeometryStream::EndFrame()
+{
+	if (persistent)
+	{
+		if (fences[frame] != nullptr)
+		{
+			glDeleteSync(fences[frame]);
+		}
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+GeometryStream::Allocation GeometryStream::Write(const void* data, size_t size)
+{
+	size_t offset = (head + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	if (offset + size > end)
+	{
+		Grow(size);
+		offset = head;
+	}
+
+	if (persistent)
+	{
+		std::memcpy(mapped + offset, data, size);
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	}
+	head = offset + size;
+
+	Allocation allocation;
+	allocation.buffer = buffer;
+	allocation.offset = offset;
+	return allocation;
+}
+
+void GeometryStream::Grow(size_t minRegionSize)
+{
+	retiredBuffers.push_back(buffer);
+
+	// The new buffer has never been drawn from, none of its regions need waiting for
+	for (GLsync& fence : fences)
+	{
+		if (fence != nullptr)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	regionSize = std::max(regionSize * 2, minRegionSize + ALIGNMENT);
+	CreateBuffer();
+
+	head = persistent ? frame * regionSize : 0;
+	end = head + regionSize;
+}
+
+void GeometryStream::CreateBuffer()
+{
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+	if (persistent)
+	{
+		const GLsizeiptr size = regionSize * FRAMES_IN_FLIGHT;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (mapped != nullptr)
+		{
+			return;
+		}
+
+		// Could not map it after all, orphaning works everywhere
+		glDeleteBuffers(1, &buffer);
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		persistent = false;
+	}
+
+	glBufferData(GL_COPY_WRITE_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+	mapped = nullptr;
+}
+
+bool GeometryStream::HasBufferStorage()
+{
+	if (glBufferStorage == nullptr)
+	{
+		return false;
+	}
+
+	if (gl3w_is_supported(4, 4))
+	{
+		return true;
+	}
+
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != nullptr && std::strcmp(extension, "GL_ARB_buffer_storage") == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
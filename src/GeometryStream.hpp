@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+// Geometry that is rebuilt every frame (light polygons) is written here instead of into buffers of its own,
+// so that no mesh reallocates driver storage per frame.
+// With GL_ARB_buffer_storage the buffer is mapped once and split into one region per frame in flight, each fenced
+// so that we never write over data the GPU has not drawn yet. Without it, the buffer is orphaned at every frame start
+class GeometryStream
+{
+public:
+	// Where some written data ended up, valid until the next BeginFrame
+	struct Allocation
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+	};
+
+public:
+	GeometryStream() {}
+
+	// Singleton
+	static GeometryStream& GetInstance()
+	{
+		static GeometryStream instance;
+		return instance;
+	}
+
+	// Make sure these functions never get called (or else we may end up with more than 1 GeometryStream)
+	GeometryStream(GeometryStream const &) = delete;
+	void operator=(GeometryStream const &) = delete;
+
+	// Creates the buffer. Should be called once GL functions are loaded
+	bool Init();
+	void Destroy();
+
+	// Should be called before anything is written for the frame, and after all of its draws have been issued
+	void BeginFrame();
+	void EndFrame();
+
+	// Copies data into the current frame's region
+	Allocation Write(const void* data, size_t size);
+
+	bool IsPersistent() const { return persistent; }
+
+private:
+	// Replaces the buffer by one whose regions hold at least minRegionSize bytes. The old one is deleted next frame,
+	// once the draws that use it have been issued
+	void Grow(size_t minRegionSize);
+	void CreateBuffer();
+
+	static bool HasBufferStorage();
+
+private:
+	// Frames the GPU may still be drawing while we write the next one
+	static const int FRAMES_IN_FLIGHT = 3;
+
+	bool persistent = false;
+
+	GLuint buffer = 0;
+	char* mapped = nullptr;
+	size_t regionSize = 1 << 20;
+
+	int frame = 0;
+	GLsync fences[FRAMES_IN_FLIGHT] = {};
+
+	// Free part of the current region
+	size_t head = 0;
+	size_t end = 0;
+
+	std::vector<GLuint> retiredBuffers;
+};
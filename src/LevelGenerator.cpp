@@ -11,13 +11,12 @@
 #include "LightWall.hpp"
 #include "DarkWall.hpp"
 #include "hint.hpp"
+#include "CollisionManager.hpp"
 
 #include <iostream>
 #include <string.h>
 #include <sstream>
 
-#define BLOCK_SIZE 64
-
 std::map<char, StaticTile> LevelGenerator::tile_map = {
         {'#', WALL},
         {'$', GLASS},
@@ -294,6 +293,11 @@ bool LevelGenerator::add_tile(int x_pos, int y_pos, StaticTile tile, Player& out
 		return false;
     }
 
+    // Walls and glass never move, so their collisions are resolved through the tile map
+    if (tile == WALL || tile == GLASS || tile == DARKWALL || tile == LIGHTWALL) {
+        CollisionManager::GetInstance().RegisterStaticTile(level_entity, x_pos, y_pos);
+    }
+
 	CreatedEntity createdEntity;
 	createdEntity.x = x_pos;
 	createdEntity.y = y_pos;
@@ -322,6 +326,12 @@ void LevelGenerator::print_grid(std::vector<std::vector<char>>& grid) {
 }
 
 void LevelGenerator::create_level(std::vector<std::vector<char>>& grid, Player& outPlayer, std::vector<Entity*>& outEntities) {
+	size_t levelWidth = 0;
+	for (const std::vector<char>& row : grid) {
+		levelWidth = std::max(levelWidth, row.size());
+	}
+	CollisionManager::GetInstance().ResetTileMap((int)levelWidth, (int)grid.size());
+
 	std::vector<CreatedEntity> createdEntities;
 	for (int y = 0; y < grid.size(); y++) {
         for (int x = 0; x < grid[y].size(); x++) {
@@ -387,8 +397,94 @@ void LevelGenerator::create_level(std::vector<std::vector<char>>& grid, Player&
 		}
 	}
 
+	merge_wall_outlines(createdEntities, (int)levelWidth, (int)grid.size());
+
 	for (const CreatedEntity& createdEntity : createdEntities)
 	{
 		outEntities.push_back(createdEntity.entity);
 	}
 }
+
+void LevelGenerator::merge_wall_outlines(const std::vector<CreatedEntity>& createdEntities, int levelWidth, int levelHeight) {
+	// Same walls as the neighbour pass, the others keep their own edges
+	std::vector<Wall*> walls((size_t)levelWidth * levelHeight, nullptr);
+	for (const CreatedEntity& createdEntity : createdEntities)
+	{
+		Wall* wall = dynamic_cast<Wall*>(createdEntity.entity);
+		if (wall && wall->no_neighboring_walls())
+		{
+			walls[createdEntity.y * levelWidth + createdEntity.x] = wall;
+		}
+	}
+
+	auto isWall = [&](int x, int y)
+	{
+		return x >= 0 && y >= 0 && x < levelWidth && y < levelHeight && walls[y * levelWidth + x];
+	};
+
+	const float halfBlock = BLOCK_SIZE / 2.f;
+	ParametricLines outline;
+
+	// Horizontal edges, one row of tiles at a time. Side -1 is the edge shared with the row above, +1 the one below
+	for (int y = 0; y < levelHeight; y++)
+	{
+		for (int side : { -1, 1 })
+		{
+			int runStart = -1;
+			for (int x = 0; x <= levelWidth; x++)
+			{
+				const bool exposed = isWall(x, y) && !isWall(x, y + side);
+				if (exposed && runStart == -1)
+				{
+					runStart = x;
+				}
+				else if (!exposed && runStart != -1)
+				{
+					ParametricLine edge;
+					edge.x_0 = runStart * BLOCK_SIZE - halfBlock;
+					edge.x_t = (x - runStart) * BLOCK_SIZE;
+					edge.y_0 = y * BLOCK_SIZE + side * halfBlock;
+					edge.y_t = 0.f;
+					outline.push_back(edge);
+					runStart = -1;
+				}
+			}
+		}
+	}
+
+	// Vertical edges, one column of tiles at a time
+	for (int x = 0; x < levelWidth; x++)
+	{
+		for (int side : { -1, 1 })
+		{
+			int runStart = -1;
+			for (int y = 0; y <= levelHeight; y++)
+			{
+				const bool exposed = isWall(x, y) && !isWall(x + side, y);
+				if (exposed && runStart == -1)
+				{
+					runStart = y;
+				}
+				else if (!exposed && runStart != -1)
+				{
+					ParametricLine edge;
+					edge.x_0 = x * BLOCK_SIZE + side * halfBlock;
+					edge.x_t = 0.f;
+					edge.y_0 = runStart * BLOCK_SIZE - halfBlock;
+					edge.y_t = (y - runStart) * BLOCK_SIZE;
+					outline.push_back(edge);
+					runStart = -1;
+				}
+			}
+		}
+	}
+
+	for (Wall* wall : walls)
+	{
+		if (wall)
+		{
+			wall->SetOutlineMerged(true);
+		}
+	}
+	CollisionManager::GetInstance().RegisterStaticOutline(outline);
+}
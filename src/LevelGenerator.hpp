@@ -24,6 +24,10 @@ private:
 
 	bool add_tile(int x_pos, int y_pos, StaticTile tile, Player& outPlayer, std::vector<CreatedEntity>& outCreateEntities);
 
+	// Merges the exposed edges of neighbouring walls into the longest straight segments possible,
+	// so that lights test a few long outlines rather than every wall edge
+	void merge_wall_outlines(const std::vector<CreatedEntity>& createdEntities, int levelWidth, int levelHeight);
+
 	void print_grid(std::vector<std::vector<char>>& grid);
 
 	template <class TEntity>
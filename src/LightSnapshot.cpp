@@ -0,0 +1,166 @@
+#include <cmath>
+#include <algorithm>
+#include "LightSnapshot.hpp"
+
+void LightSnapshot::Clear()
+{
+	boxes.Clear();
+	items.clear();
+	boundaryLines.clear();
+	occluderX0.clear();
+	occluderY0.clear();
+	occluderDX.clear();
+	occluderDY.clear();
+}
+
+void LightSnapshot::Add(Entity* entity, vec2 position, vec2 halfBound, uint32_t flags)
+{
+	const int slot = boxes.Insert(entity, position, { halfBound.x * 2, halfBound.y * 2 });
+	boxes.SetFlag(slot, flags, true);
+
+	Item item;
+	item.entity = entity;
+	item.firstBoundary = (int)boundaryLines.size();
+	item.boundaryCount = 0;
+	item.firstOccluder = (int)occluderX0.size();
+	item.occluderCount = 0;
+
+	// Same lines as Entity::calculate_boundary_equations, taken from the box
+	if (entity != nullptr)
+	{
+		const float rightBound = position.x + halfBound.x;
+		const float leftBound = position.x - halfBound.x;
+		const float topBound = position.y + halfBound.y;
+		const float bottomBound = position.y - halfBound.y;
+
+		boundaryLines.push_back({ rightBound, 0.f, bottomBound, topBound - bottomBound });
+		boundaryLines.push_back({ leftBound, 0.f, bottomBound, topBound - bottomBound });
+		boundaryLines.push_back({ leftBound, rightBound - leftBound, topBound, 0.f });
+		boundaryLines.push_back({ leftBound, rightBound - leftBound, bottomBound, 0.f });
+		item.boundaryCount = 4;
+	}
+
+	items.push_back(item);
+}
+
+void LightSnapshot::AddOccluders(const float* x0, const float* y0, const float* dx, const float* dy, int first, int count)
+{
+	occluderX0.insert(occluderX0.end(), x0 + first, x0 + first + count);
+	occluderY0.insert(occluderY0.end(), y0 + first, y0 + first + count);
+	occluderDX.insert(occluderDX.end(), dx + first, dx + first + count);
+	occluderDY.insert(occluderDY.end(), dy + first, dy + first + count);
+	items.back().occluderCount += count;
+}
+
+void LightSnapshot::Build()
+{
+	largeItems.clear();
+	cellItems.clear();
+	gridWidth = 0;
+	gridHeight = 0;
+
+	// Grid bounds, from the cells of the items that are not too large for them
+	int maxCellX = 0;
+	int maxCellY = 0;
+	bool hasCells = false;
+	for (int item = 0; item < (int)items.size(); item++)
+	{
+		const vec2 halfBound = boxes.GetHalfBound(item);
+		if (halfBound.x > CELL_SIZE / 2 || halfBound.y > CELL_SIZE / 2)
+		{
+			largeItems.push_back(item);
+			continue;
+		}
+
+		const vec2 position = boxes.GetPosition(item);
+		const int cellX = (int)std::floor(position.x / CELL_SIZE);
+		const int cellY = (int)std::floor(position.y / CELL_SIZE);
+		if (!hasCells)
+		{
+			gridMinX = maxCellX = cellX;
+			gridMinY = maxCellY = cellY;
+			hasCells = true;
+		}
+		gridMinX = std::min(gridMinX, cellX);
+		gridMinY = std::min(gridMinY, cellY);
+		maxCellX = std::max(maxCellX, cellX);
+		maxCellY = std::max(maxCellY, cellY);
+	}
+
+	if (!hasCells)
+	{
+		cellStarts.assign(1, 0);
+		return;
+	}
+	gridWidth = maxCellX - gridMinX + 1;
+	gridHeight = maxCellY - gridMinY + 1;
+
+	// Counting sort by cell, items of a cell stay in increasing order
+	cellStarts.assign(gridWidth * gridHeight + 1, 0);
+	size_t largeIndex = 0;
+	for (int item = 0; item < (int)items.size(); item++)
+	{
+		if (largeIndex < largeItems.size() && largeItems[largeIndex] == item)
+		{
+			largeIndex++;
+			continue;
+		}
+		const vec2 position = boxes.GetPosition(item);
+		cellStarts[CellOf(position.x, position.y) + 1]++;
+	}
+	for (int cell = 0; cell < gridWidth * gridHeight; cell++)
+	{
+		cellStarts[cell + 1] += cellStarts[cell];
+	}
+
+	cellItems.resize(items.size() - largeItems.size());
+	std::vector<int> cellFill(cellStarts.begin(), cellStarts.end() - 1);
+	largeIndex = 0;
+	for (int item = 0; item < (int)items.size(); item++)
+	{
+		if (largeIndex < largeItems.size() && largeItems[largeIndex] == item)
+		{
+			largeIndex++;
+			continue;
+		}
+		const vec2 position = boxes.GetPosition(item);
+		cellItems[cellFill[CellOf(position.x, position.y)]++] = item;
+	}
+}
+
+void LightSnapshot::QueryInRadius(vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outItems) const
+{
+	const size_t firstOut = outItems.size();
+
+	// An item reaching the circle has its center at most half a cell further away
+	const float reach = radius + CELL_SIZE / 2;
+	const int minCellX = std::max((int)std::floor((position.x - reach) / CELL_SIZE) - gridMinX, 0);
+	const int minCellY = std::max((int)std::floor((position.y - reach) / CELL_SIZE) - gridMinY, 0);
+	const int maxCellX = std::min((int)std::floor((position.x + reach) / CELL_SIZE) - gridMinX, gridWidth - 1);
+	const int maxCellY = std::min((int)std::floor((position.y + reach) / CELL_SIZE) - gridMinY, gridHeight - 1);
+
+	// Cells of a row are next to each other, so a row is filtered in one go
+	for (int cellY = minCellY; cellY <= maxCellY && minCellX <= maxCellX; cellY++)
+	{
+		const int first = cellStarts[cellY * gridWidth + minCellX];
+		const int last = cellStarts[cellY * gridWidth + maxCellX + 1];
+		if (last > first)
+		{
+			boxes.FilterInRadius(cellItems.data() + first, last - first, position, radius, requiredFlags, excludedFlags, outItems);
+		}
+	}
+
+	if (!largeItems.empty())
+	{
+		boxes.FilterInRadius(largeItems.data(), (int)largeItems.size(), position, radius, requiredFlags, excludedFlags, outItems);
+	}
+
+	std::sort(outItems.begin() + firstOut, outItems.end());
+}
+
+int LightSnapshot::CellOf(float x, float y) const
+{
+	const int cellX = (int)std::floor(x / CELL_SIZE) - gridMinX;
+	const int cellY = (int)std::floor(y / CELL_SIZE) - gridMinY;
+	return cellY * gridWidth + cellX;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+#include "AabbStore.hpp"
+
+class Entity;
+
+// Everything lights need from the CollisionManager, copied once per frame: the box of each registered entity and outline,
+// its boundary lines (to find what a light reaches) and its light blocking lines, all in world space.
+// It does not change until rebuilt, so every light, on any thread, reads the same data without calling into entities
+class LightSnapshot
+{
+public:
+	struct Item
+	{
+		Entity* entity;			// nullptr for lines that belong to no entity (merged wall outlines)
+		int firstBoundary;		// Boundary lines are GetBoundaryLines()[firstBoundary] to [firstBoundary + boundaryCount]
+		int boundaryCount;
+		int firstOccluder;		// Light blocking lines are occluders [firstOccluder, firstOccluder + occluderCount)
+		int occluderCount;
+	};
+
+public:
+	// Building, done by the CollisionManager
+	void Clear();
+	void Add(Entity* entity, vec2 position, vec2 halfBound, uint32_t flags);
+	void AddOccluders(const float* x0, const float* y0, const float* dx, const float* dy, int first, int count);
+	void Build();
+
+	// Appends the items whose box is closer than radius to the given point, in increasing order.
+	// Only items with all of requiredFlags and none of excludedFlags (AabbStore::Flags) are considered
+	void QueryInRadius(vec2 position, float radius, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<int>& outItems) const;
+
+	int GetItemCount() const { return (int)items.size(); }
+	const Item& GetItem(int item) const { return items[item]; }
+	vec2 GetPosition(int item) const { return boxes.GetPosition(item); }
+	vec2 GetHalfBound(int item) const { return boxes.GetHalfBound(item); }
+
+	const ParametricLines& GetBoundaryLines() const { return boundaryLines; }
+
+	// Occluder i is x = x0[i] + dx[i] * t, y = y0[i] + dy[i] * t for 0 <= t <= 1
+	ParametricLine GetOccluder(int i) const { return { occluderX0[i], occluderDX[i], occluderY0[i], occluderDY[i] }; }
+	const float* GetOccluderX0() const { return occluderX0.data(); }
+	const float* GetOccluderY0() const { return occluderY0.data(); }
+	const float* GetOccluderDX() const { return occluderDX.data(); }
+	const float* GetOccluderDY() const { return occluderDY.data(); }
+
+private:
+	// Items are filed under the grid cell of their center only. Those larger than a cell are kept apart and always tested
+	static const int CELL_SIZE = BLOCK_SIZE * 4;
+
+	int CellOf(float x, float y) const;
+
+private:
+	AabbStore boxes;
+	std::vector<Item> items;
+
+	ParametricLines boundaryLines;
+
+	std::vector<float> occluderX0;
+	std::vector<float> occluderY0;
+	std::vector<float> occluderDX;
+	std::vector<float> occluderDY;
+
+	// Items of cell c are cellItems[cellStarts[c]] to cellItems[cellStarts[c + 1]], cells in rows of gridWidth
+	int gridMinX = 0;
+	int gridMinY = 0;
+	int gridWidth = 0;
+	int gridHeight = 0;
+	std::vector<int> cellStarts;
+	std::vector<int> cellItems;
+	std::vector<int> largeItems;
+};
@@ -12,6 +12,7 @@ void LightWall::activate()
 	{
 		isCollidable = true;
 	}
+	CollisionManager::GetInstance().UpdateEntityCollidability(this);
 }
 
 void LightWall::deactivate()
@@ -19,6 +20,7 @@ void LightWall::deactivate()
 	set_lit(false);
 	isCollidable = false;
 	shouldBeCollidable = false;
+	CollisionManager::GetInstance().UpdateEntityCollidability(this);
 }
 
 void LightWall::update(float ms)
@@ -29,6 +31,7 @@ void LightWall::update(float ms)
 		{
 			isCollidable = true;
 			shouldBeCollidable = false;
+			CollisionManager::GetInstance().UpdateEntityCollidability(this);
 		}
 	}
 }
\ No newline at end of file
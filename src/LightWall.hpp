@@ -11,8 +11,12 @@ public:
 	virtual EntityColor get_color() const override { return EntityColor({ 0.8, 0.8, 0.8, 1.0 }); }
 
 	bool is_light_dynamic() const override { return false; }
+	bool lit_changes_gameplay() const override { return true; }
 	virtual bool no_neighboring_walls() const override { return false; }
 
+	// Left out of the merged level outline, so it blocks light with its own box while collidable
+	ParametricLines calculate_static_equations() const override { return Entity::calculate_static_equations(); }
+
 	virtual void activate() override;
 	virtual void deactivate() override;
 
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include "SegmentArena.hpp"
+
+int SegmentArena::Insert(const ParametricLines& lines)
+{
+	int range;
+	if (!freeRanges.empty())
+	{
+		range = freeRanges.back();
+		freeRanges.pop_back();
+	}
+	else
+	{
+		range = (int)ranges.size();
+		ranges.push_back({ 0, 0, 0 });
+	}
+
+	const int count = (int)lines.size();
+	ranges[range] = { count > 0 ? AllocateBlock(count) : 0, count, count };
+	Write(ranges[range].first, lines);
+	return range;
+}
+
+void SegmentArena::Assign(int range, const ParametricLines& lines)
+{
+	const int count = (int)lines.size();
+	if (count > ranges[range].capacity)
+	{
+		// Emptied first, freeing may compact the arena and this range should not be kept
+		const Range previous = ranges[range];
+		ranges[range] = { 0, 0, 0 };
+		if (previous.capacity > 0)
+		{
+			FreeBlock(previous.first, previous.capacity);
+		}
+
+		ranges[range] = { AllocateBlock(count), count, count };
+	}
+
+	ranges[range].count = count;
+	Write(ranges[range].first, lines);
+}
+
+void SegmentArena::Remove(int range)
+{
+	const Range previous = ranges[range];
+	ranges[range] = { 0, 0, 0 };
+	freeRanges.push_back(range);
+
+	if (previous.capacity > 0)
+	{
+		FreeBlock(previous.first, previous.capacity);
+	}
+}
+
+int SegmentArena::AllocateBlock(int capacity)
+{
+	// First fit in the space left by removed ranges
+	for (size_t i = 0; i < freeBlocks.size(); i++)
+	{
+		Block& block = freeBlocks[i];
+		if (block.capacity >= capacity)
+		{
+			const int first = block.first;
+			block.first += capacity;
+			block.capacity -= capacity;
+			freeSegments -= capacity;
+
+			if (block.capacity == 0)
+			{
+				block = freeBlocks.back();
+				freeBlocks.pop_back();
+			}
+			return first;
+		}
+	}
+
+	const int first = (int)x0.size();
+	x0.resize(first + capacity);
+	y0.resize(first + capacity);
+	dx.resize(first + capacity);
+	dy.resize(first + capacity);
+	return first;
+}
+
+void SegmentArena::FreeBlock(int first, int capacity)
+{
+	freeBlocks.push_back({ first, capacity });
+	freeSegments += capacity;
+
+	// Small holes are cheap to keep around, compact once they take most of the arena
+	const int MIN_FREE_SEGMENTS_TO_COMPACT = 256;
+	if (freeSegments >= MIN_FREE_SEGMENTS_TO_COMPACT && freeSegments * 2 > (int)x0.size())
+	{
+		Compact();
+	}
+}
+
+void SegmentArena::Write(int first, const ParametricLines& lines)
+{
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		x0[first + i] = lines[i].x_0;
+		y0[first + i] = lines[i].y_0;
+		dx[first + i] = lines[i].x_t;
+		dy[first + i] = lines[i].y_t;
+	}
+}
+
+void SegmentArena::Compact()
+{
+	// Keep ranges in the order they already were in, so that neighbours stay neighbours
+	std::vector<int> liveRanges;
+	for (int range = 0; range < (int)ranges.size(); range++)
+	{
+		if (ranges[range].capacity > 0)
+		{
+			liveRanges.push_back(range);
+		}
+	}
+	std::sort(liveRanges.begin(), liveRanges.end(), [this](int range1, int range2)
+	{
+		return ranges[range1].first < ranges[range2].first;
+	});
+
+	int size = 0;
+	for (int range : liveRanges)
+	{
+		Range& live = ranges[range];
+		for (int i = 0; i < live.count; i++)
+		{
+			x0[size + i] = x0[live.first + i];
+			y0[size + i] = y0[live.first + i];
+			dx[size + i] = dx[live.first + i];
+			dy[size + i] = dy[live.first + i];
+		}
+
+		live.first = size;
+		live.capacity = live.count;
+		size += live.count;
+	}
+
+	x0.resize(size);
+	y0.resize(size);
+	dx.resize(size);
+	dy.resize(size);
+
+	freeBlocks.clear();
+	freeSegments = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+// Light occluder segments of every entity, stored contiguously (one array per component) so that
+// light code can stream through them. Each owner gets a range of segments, identified by an id that stays valid until removed.
+// Freed space is reused by later ranges, and the arena compacts itself once too much of it is free.
+class SegmentArena
+{
+public:
+	// Stores lines in a new range and returns its id
+	int Insert(const ParametricLines& lines);
+
+	// Replaces the lines of a range, moving it elsewhere in the arena if they no longer fit
+	void Assign(int range, const ParametricLines& lines);
+
+	void Remove(int range);
+
+	// Segments [GetFirst(range), GetFirst(range) + GetCount(range)) belong to the range
+	int GetFirst(int range) const { return ranges[range].first; }
+	int GetCount(int range) const { return ranges[range].count; }
+
+	// Segment i is x = x0[i] + dx[i] * t, y = y0[i] + dy[i] * t for 0 <= t <= 1
+	const float* GetX0() const { return x0.data(); }
+	const float* GetY0() const { return y0.data(); }
+	const float* GetDX() const { return dx.data(); }
+	const float* GetDY() const { return dy.data(); }
+
+private:
+	struct Range
+	{
+		int first;
+		int count;
+		int capacity;
+	};
+
+	struct Block
+	{
+		int first;
+		int capacity;
+	};
+
+	int AllocateBlock(int capacity);
+	void FreeBlock(int first, int capacity);
+	void Write(int first, const ParametricLines& lines);
+	void Compact();
+
+private:
+	std::vector<float> x0;
+	std::vector<float> y0;
+	std::vector<float> dx;
+	std::vector<float> dy;
+
+	std::vector<Range> ranges;
+	std::vector<int> freeRanges;
+
+	// Unused space between ranges
+	std::vector<Block> freeBlocks;
+	int freeSegments = 0;
+};
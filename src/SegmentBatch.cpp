@@ -0,0 +1,225 @@
+#include <limits>
+#include "SegmentBatch.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEGMENT_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#ifdef SEGMENT_BATCH_SSE2
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+#endif
+}
+
+void SegmentBatch::Clear()
+{
+	x0.clear();
+	y0.clear();
+	dx.clear();
+	dy.clear();
+}
+
+void SegmentBatch::Add(const ParametricLine& line)
+{
+	x0.push_back(line.x_0);
+	y0.push_back(line.y_0);
+	dx.push_back(line.x_t);
+	dy.push_back(line.y_t);
+}
+
+int SegmentBatch::Raycast(const ParametricLine& ray, float maxTime, float& outTime) const
+{
+	return Raycast(ray, maxTime, x0.data(), y0.data(), dx.data(), dy.data(), 0, GetCount(), outTime);
+}
+
+int SegmentBatch::RaycastRange(const ParametricLine& ray, float maxTime, int first, int last, float& outTime) const
+{
+	return Raycast(ray, maxTime, x0.data(), y0.data(), dx.data(), dy.data(), first, last, outTime);
+}
+
+void SegmentBatch::RaycastAll(const ParametricLine& ray, float maxTime, const int* indices, int count, std::vector<int>& outHits) const
+{
+	for (int j = 0; j < count; j++)
+	{
+		const int i = indices[j];
+		const float wX = x0[i] - ray.x_0;
+		const float wY = y0[i] - ray.y_0;
+		const float denominator = ray.x_t * dy[i] - ray.y_t * dx[i];
+		const float rayTime = (wX * dy[i] - wY * dx[i]) / denominator;
+		const float segmentTime = (wX * ray.y_t - wY * ray.x_t) / denominator;
+
+		if (rayTime >= 0.f && rayTime <= maxTime && segmentTime >= 0.f && segmentTime <= 1.f)
+		{
+			outHits.push_back(i);
+		}
+	}
+}
+
+int SegmentBatch::Raycast(const ParametricLine& ray, float maxTime, const int* indices, int count, float& outTime) const
+{
+	// Indices are scattered, so segments are tested one at a time
+	float bestTime = std::numeric_limits<float>::infinity();
+	int bestIndex = -1;
+	for (int j = 0; j < count; j++)
+	{
+		const int i = indices[j];
+		const float wX = x0[i] - ray.x_0;
+		const float wY = y0[i] - ray.y_0;
+		const float denominator = ray.x_t * dy[i] - ray.y_t * dx[i];
+		const float rayTime = (wX * dy[i] - wY * dx[i]) / denominator;
+		const float segmentTime = (wX * ray.y_t - wY * ray.x_t) / denominator;
+
+		if (rayTime >= 0.f && rayTime <= maxTime && segmentTime >= 0.f && segmentTime <= 1.f && rayTime < bestTime)
+		{
+			bestTime = rayTime;
+			bestIndex = i;
+		}
+	}
+
+	if (bestIndex != -1)
+	{
+		outTime = bestTime;
+	}
+	return bestIndex;
+}
+
+int SegmentBatch::Raycast(const ParametricLine& ray, float maxTime, const float* x0, const float* y0, const float* dx, const float* dy, int first, int last, float& outTime)
+{
+	// Given the ray (ox + rx*t1, oy + ry*t1) and a segment (x0 + dx*t2, y0 + dy*t2), with w = (x0 - ox, y0 - oy)
+	// t1 = cross(w, d) / cross(r, d)
+	// t2 = cross(w, r) / cross(r, d)
+	// Parallel segments divide by zero, which gives infinities or NaN that fail every comparison below
+	const float infinity = std::numeric_limits<float>::infinity();
+	float bestTime = infinity;
+	int bestIndex = -1;
+	int i = first;
+
+#ifdef SEGMENT_BATCH_SSE2
+	if (last - first >= 4)
+	{
+		const __m128 originX = _mm_set1_ps(ray.x_0);
+		const __m128 originY = _mm_set1_ps(ray.y_0);
+		const __m128 rayX = _mm_set1_ps(ray.x_t);
+		const __m128 rayY = _mm_set1_ps(ray.y_t);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 maxTime4 = _mm_set1_ps(maxTime);
+
+		__m128 bestTimes = _mm_set1_ps(infinity);
+		__m128 bestIndices = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128i indices = _mm_setr_epi32(i, i + 1, i + 2, i + 3);
+		const __m128i four = _mm_set1_epi32(4);
+
+		for (; i + 4 <= last; i += 4)
+		{
+			const __m128 segmentX = _mm_loadu_ps(dx + i);
+			const __m128 segmentY = _mm_loadu_ps(dy + i);
+			const __m128 wX = _mm_sub_ps(_mm_loadu_ps(x0 + i), originX);
+			const __m128 wY = _mm_sub_ps(_mm_loadu_ps(y0 + i), originY);
+
+			const __m128 denominator = _mm_sub_ps(_mm_mul_ps(rayX, segmentY), _mm_mul_ps(rayY, segmentX));
+			const __m128 rayTime = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(wX, segmentY), _mm_mul_ps(wY, segmentX)), denominator);
+			const __m128 segmentTime = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(wX, rayY), _mm_mul_ps(wY, rayX)), denominator);
+
+			__m128 hits = _mm_and_ps(_mm_cmpge_ps(rayTime, zero), _mm_cmple_ps(rayTime, maxTime4));
+			hits = _mm_and_ps(hits, _mm_and_ps(_mm_cmpge_ps(segmentTime, zero), _mm_cmple_ps(segmentTime, one)));
+			hits = _mm_and_ps(hits, _mm_cmplt_ps(rayTime, bestTimes));
+
+			bestTimes = Select(hits, rayTime, bestTimes);
+			bestIndices = Select(hits, _mm_castsi128_ps(indices), bestIndices);
+			indices = _mm_add_epi32(indices, four);
+		}
+
+		// Nearest of the four lanes, the lowest index on ties like the plain loop
+		alignas(16) float laneTimes[4];
+		alignas(16) int laneIndices[4];
+		_mm_store_ps(laneTimes, bestTimes);
+		_mm_store_si128((__m128i*)laneIndices, _mm_castps_si128(bestIndices));
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (laneIndices[lane] != -1 && (laneTimes[lane] < bestTime || (laneTimes[lane] == bestTime && laneIndices[lane] < bestIndex)))
+			{
+				bestTime = laneTimes[lane];
+				bestIndex = laneIndices[lane];
+			}
+		}
+	}
+#endif
+
+	for (; i < last; i++)
+	{
+		const float wX = x0[i] - ray.x_0;
+		const float wY = y0[i] - ray.y_0;
+		const float denominator = ray.x_t * dy[i] - ray.y_t * dx[i];
+		const float rayTime = (wX * dy[i] - wY * dx[i]) / denominator;
+		const float segmentTime = (wX * ray.y_t - wY * ray.x_t) / denominator;
+
+		if (rayTime >= 0.f && rayTime <= maxTime && segmentTime >= 0.f && segmentTime <= 1.f && rayTime < bestTime)
+		{
+			bestTime = rayTime;
+			bestIndex = i;
+		}
+	}
+
+	if (bestIndex != -1)
+	{
+		outTime = bestTime;
+	}
+	return bestIndex;
+}
+
+bool SegmentBatch::LinesCollide(const ParametricLine& line1, const ParametricLine& line2, vec2& collisionPos)
+{
+	// Given
+	// line1 : x1 = a1 + b1*t1, y1 = c1 + d1*t1
+	// line2 : x2 = a2 + b2*t2, y2 = c2 + d2*t2
+	// A collision means a pair of t1 and t2 that are both 0 < t < 1
+
+	// Algebra gives:
+	// t2 = (c1 - c2 + d1*a2/b1 - d1*a1/b1) / (d2 - d1*b2/b1)
+	// t1 = (a2 + b2 * t2) / b1
+
+	// However we must consider the case where b1 == 0
+	// In that case we use the alternate equations
+	// t2 = (a1-a2)/b2
+	// t1 = (c2 - c1 + d2*t2) / d1
+
+	float epsilon = 0.0001f;
+	float a1 = line1.x_0;
+	float b1 = line1.x_t;
+	float c1 = line1.y_0;
+	float d1 = line1.y_t;
+	float a2 = line2.x_0;
+	float b2 = line2.x_t;
+	float c2 = line2.y_0;
+	float d2 = line2.y_t;
+
+	if (-epsilon < b1 && b1 < epsilon) // when b1 == 0
+	{
+		float t2 = (a1 - a2) / b2;
+		float t1 = (c2 - c1 + d2*t2) / d1;
+
+		if (0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1)
+		{
+			collisionPos = { a1 + b1 * t1, c1 + d1 * t1 };
+			return true;
+		}
+	}
+	else
+	{
+		float t2 = (c1 - c2 + d1 * a2 / b1 - d1 * a1 / b1) / (d2 - d1 * b2 / b1);
+		float t1 = (a2 + b2 * t2) / b1;
+		if (0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1)
+		{
+			collisionPos = { a1 + b1 * t1, c1 + d1 * t1 };
+			return true;
+		}
+	}
+
+	return false;
+}
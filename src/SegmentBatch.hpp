@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+// Segments packed one array per component, so that a ray can be tested against several of them at once.
+// Raycast is the batched version of LinesCollide, looking for the nearest hit only
+class SegmentBatch
+{
+public:
+	void Clear();
+	void Add(const ParametricLine& line);
+
+	int GetCount() const { return (int)x0.size(); }
+
+	// Index of the nearest segment the ray hits at a time (0 <= t <= maxTime along the ray) before any other, or -1.
+	// outTime is left untouched when nothing is hit
+	int Raycast(const ParametricLine& ray, float maxTime, float& outTime) const;
+
+	// Same as above, only against the segments at the given indices (e.g. those of one AngularBins sector)
+	int Raycast(const ParametricLine& ray, float maxTime, const int* indices, int count, float& outTime) const;
+
+	// Same as above, only against segments [first, last) (e.g. the boundary lines of one entity)
+	int RaycastRange(const ParametricLine& ray, float maxTime, int first, int last, float& outTime) const;
+
+	// Same as above, for segments [first, last) of already packed arrays (e.g. a SegmentArena)
+	static int Raycast(const ParametricLine& ray, float maxTime, const float* x0, const float* y0, const float* dx, const float* dy, int first, int last, float& outTime);
+
+	// Appends every segment at the given indices the ray hits (0 <= t <= maxTime), not only the nearest one
+	void RaycastAll(const ParametricLine& ray, float maxTime, const int* indices, int count, std::vector<int>& outHits) const;
+
+	// Whether two segments cross, and where. One pair at a time, what lights used before the batches; kept as the reference for bench_segments.
+	// Only exact when line1 starts at x = 0 or is vertical, as light rays always are
+	static bool LinesCollide(const ParametricLine& line1, const ParametricLine& line2, vec2& collisionPos);
+
+private:
+	std::vector<float> x0;
+	std::vector<float> y0;
+	std::vector<float> dx;
+	std::vector<float> dy;
+};
@@ -0,0 +1,133 @@
+#include <sstream>
+#include "ShaderCache.hpp"
+
+namespace
+{
+	bool gl_compile_shader(GLuint shader)
+	{
+		glCompileShader(shader);
+		GLint success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (success == GL_FALSE)
+		{
+			GLint log_len;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_len);
+			std::vector<char> log(log_len);
+			glGetShaderInfoLog(shader, log_len, &log_len, log.data());
+			glDeleteShader(shader);
+
+			fprintf(stderr, "GLSL: %s", log.data());
+			return false;
+		}
+
+		return true;
+	}
+}
+
+const ShaderCache::Program* ShaderCache::Borrow(const char* vs_path, const char* fs_path)
+{
+	const Key key(vs_path, fs_path);
+	auto found = programs.find(key);
+	if (found == programs.end())
+	{
+		Program program;
+		if (!Compile(vs_path, fs_path, program))
+		{
+			return nullptr;
+		}
+		found = programs.emplace(key, program).first;
+	}
+
+	return &found->second;
+}
+
+void ShaderCache::Destroy()
+{
+	for (const auto& program : programs)
+	{
+		Delete(program.second);
+	}
+	programs.clear();
+}
+
+bool ShaderCache::Compile(const char* vs_path, const char* fs_path, Program& outProgram)
+{
+	gl_flush_errors();
+
+	// Opening files
+	std::ifstream vs_is(vs_path);
+	std::ifstream fs_is(fs_path);
+
+	if (!vs_is.good() || !fs_is.good())
+	{
+		fprintf(stderr, "Failed to load shader files %s, %s", vs_path, fs_path);
+		return false;
+	}
+
+	// Reading sources
+	std::stringstream vs_ss, fs_ss;
+	vs_ss << vs_is.rdbuf();
+	fs_ss << fs_is.rdbuf();
+	std::string vs_str = vs_ss.str();
+	std::string fs_str = fs_ss.str();
+	const char* vs_src = vs_str.c_str();
+	const char* fs_src = fs_str.c_str();
+	GLsizei vs_len = (GLsizei)vs_str.size();
+	GLsizei fs_len = (GLsizei)fs_str.size();
+
+	outProgram.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(outProgram.vertex, 1, &vs_src, &vs_len);
+	outProgram.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(outProgram.fragment, 1, &fs_src, &fs_len);
+
+	// Compiling
+	// Shaders already delete if compilation fails
+	if (!gl_compile_shader(outProgram.vertex))
+	{
+		glDeleteShader(outProgram.fragment);
+		return false;
+	}
+
+	if (!gl_compile_shader(outProgram.fragment))
+	{
+		glDeleteShader(outProgram.vertex);
+		return false;
+	}
+
+	// Linking
+	outProgram.program = glCreateProgram();
+	glAttachShader(outProgram.program, outProgram.vertex);
+	glAttachShader(outProgram.program, outProgram.fragment);
+	glLinkProgram(outProgram.program);
+	{
+		GLint is_linked = 0;
+		glGetProgramiv(outProgram.program, GL_LINK_STATUS, &is_linked);
+		if (is_linked == GL_FALSE)
+		{
+			GLint log_len;
+			glGetProgramiv(outProgram.program, GL_INFO_LOG_LENGTH, &log_len);
+			std::vector<char> log(log_len);
+			glGetProgramInfoLog(outProgram.program, log_len, &log_len, log.data());
+
+			Delete(outProgram);
+			fprintf(stderr, "Link error: %s", log.data());
+			return false;
+		}
+	}
+
+	if (gl_has_errors())
+	{
+		Delete(outProgram);
+		fprintf(stderr, "OpenGL errors occured while compiling Effect");
+		return false;
+	}
+
+	return true;
+}
+
+void ShaderCache::Delete(const Program& program)
+{
+	glDeleteShader(program.vertex);
+	glDeleteShader(program.fragment);
+	glDeleteProgram(program.program);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "common.hpp"
+
+// Every Effect loading the same pair of shader files shares one program, compiled by the first of them.
+// Programs live until Destroy, even once no Effect uses them, so that reloading a level finds the programs
+// its entities need already compiled
+class ShaderCache
+{
+public:
+	struct Program
+	{
+		GLuint vertex = 0;
+		GLuint fragment = 0;
+		GLuint program = 0;
+	};
+
+public:
+	ShaderCache() {}
+
+	// Singleton
+	static ShaderCache& GetInstance()
+	{
+		static ShaderCache instance;
+		return instance;
+	}
+
+	// Make sure these functions never get called (or else we may end up with more than 1 ShaderCache)
+	ShaderCache(ShaderCache const &) = delete;
+	void operator=(ShaderCache const &) = delete;
+
+	// Program built from these shader files, compiled the first time they are asked for. nullptr if they do not compile
+	const Program* Borrow(const char* vs_path, const char* fs_path);
+
+	// Deletes every program. Should be called before the GL context goes away
+	void Destroy();
+
+private:
+	static bool Compile(const char* vs_path, const char* fs_path, Program& outProgram);
+	static void Delete(const Program& program);
+
+private:
+	typedef std::pair<std::string, std::string> Key;
+
+	std::map<Key, Program> programs;
+};
@@ -0,0 +1,182 @@
+#include <cmath>
+#include "SpriteBatch.hpp"
+#include "GeometryStream.hpp"
+
+bool SpriteBatch::Init()
+{
+	// Unit quad, same corners and winding as the entity meshes
+	TexturedVertex vertices[4];
+	vertices[0].position = { -0.5f, +0.5f, -0.02f };
+	vertices[0].texcoord = { 0.f, 1.f };
+	vertices[1].position = { +0.5f, +0.5f, -0.02f };
+	vertices[1].texcoord = { 1.f, 1.f };
+	vertices[2].position = { +0.5f, -0.5f, -0.02f };
+	vertices[2].texcoord = { 1.f, 0.f };
+	vertices[3].position = { -0.5f, -0.5f, -0.02f };
+	vertices[3].texcoord = { 0.f, 0.f };
+
+	uint16_t indices[] = { 0, 3, 1, 1, 3, 2 };
+
+	gl_flush_errors();
+
+	glGenVertexArrays(1, &quad.vao);
+	glBindVertexArray(quad.vao);
+
+	glGenBuffers(1, &quad.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, quad.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * 4, vertices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &quad.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices, GL_STATIC_DRAW);
+
+	if (!effect.load_from_file(shader_path("sprite.vs.glsl"), shader_path("sprite.fs.glsl")))
+		return false;
+
+	// Looked up once here rather than for every draw
+	projectionLocation = glGetUniformLocation(effect.program, "projection");
+	positionLocation = glGetAttribLocation(effect.program, "in_position");
+	texcoordLocation = glGetAttribLocation(effect.program, "in_texcoord");
+	transformLocation[0] = glGetAttribLocation(effect.program, "in_transform0");
+	transformLocation[1] = glGetAttribLocation(effect.program, "in_transform1");
+	transformLocation[2] = glGetAttribLocation(effect.program, "in_transform2");
+	colorLocation = glGetAttribLocation(effect.program, "in_color");
+
+	// The quad never changes, only the instance attributes are pointed somewhere else for each batch
+	glEnableVertexAttribArray(positionLocation);
+	glEnableVertexAttribArray(texcoordLocation);
+	glVertexAttribPointer(positionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+	glVertexAttribPointer(texcoordLocation, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+	for (GLint location : transformLocation)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+	glEnableVertexAttribArray(colorLocation);
+	glVertexAttribDivisor(colorLocation, 1);
+
+	glBindVertexArray(0);
+	return !gl_has_errors();
+}
+
+void SpriteBatch::Destroy()
+{
+	glDeleteBuffers(1, &quad.vbo);
+	glDeleteBuffers(1, &quad.ibo);
+	glDeleteVertexArrays(1, &quad.vao);
+
+	effect.release();
+
+	batches.clear();
+	batchCount = 0;
+}
+
+void SpriteBatch::Begin(const mat3& projection)
+{
+	Flush();
+	this->projection = projection;
+}
+
+void SpriteBatch::Add(GLuint texture, const mat3& transform, vec2 size, const float color[4])
+{
+	// The quad is a unit one, scaled to the sprite's size before its own transform
+	Instance instance;
+	instance.transform[0] = { transform.c0.x * size.x, transform.c0.y * size.x, transform.c0.z * size.x };
+	instance.transform[1] = { transform.c1.x * size.y, transform.c1.y * size.y, transform.c1.z * size.y };
+	instance.transform[2] = transform.c2;
+	for (int i = 0; i < 4; i++)
+	{
+		instance.color[i] = color[i];
+	}
+
+	const vec2 center = { transform.c2.x, transform.c2.y };
+	const vec2 halfExtent = {
+		0.5f * (std::fabs(instance.transform[0].x) + std::fabs(instance.transform[1].x)),
+		0.5f * (std::fabs(instance.transform[0].y) + std::fabs(instance.transform[1].y)) };
+	const vec2 boundsMin = center - halfExtent;
+	const vec2 boundsMax = center + halfExtent;
+
+	int batch = FindBatch(texture);
+
+	// Batches after ours are drawn over it. If one of them has something under this sprite, the sprite would end up
+	// below what was added before it, so draw what we have first
+	for (int later = batch + 1; later < batchCount; later++)
+	{
+		if (boundsMin.x < batches[later].boundsMax.x && batches[later].boundsMin.x < boundsMax.x &&
+			boundsMin.y < batches[later].boundsMax.y && batches[later].boundsMin.y < boundsMax.y)
+		{
+			Flush();
+			batch = FindBatch(texture);
+			break;
+		}
+	}
+
+	if (batch == batchCount)
+	{
+		if (batchCount == (int)batches.size())
+		{
+			batches.emplace_back();
+		}
+		batches[batch].texture = texture;
+		batches[batch].boundsMin = boundsMin;
+		batches[batch].boundsMax = boundsMax;
+		batchCount++;
+	}
+	else
+	{
+		batches[batch].boundsMin = { std::fmin(batches[batch].boundsMin.x, boundsMin.x), std::fmin(batches[batch].boundsMin.y, boundsMin.y) };
+		batches[batch].boundsMax = { std::fmax(batches[batch].boundsMax.x, boundsMax.x), std::fmax(batches[batch].boundsMax.y, boundsMax.y) };
+	}
+	batches[batch].instances.push_back(instance);
+}
+
+int SpriteBatch::FindBatch(GLuint texture) const
+{
+	// Few textures are in use at once, a linear search finds them quicker than a map would
+	int batch = 0;
+	while (batch < batchCount && batches[batch].texture != texture)
+	{
+		batch++;
+	}
+	return batch;
+}
+
+void SpriteBatch::Flush()
+{
+	if (batchCount == 0)
+	{
+		return;
+	}
+
+	glUseProgram(effect.program);
+
+	// Enabling alpha channel for textures
+	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	glUniformMatrix3fv(projectionLocation, 1, GL_FALSE, (float*)&projection);
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(quad.vao);
+
+	GeometryStream& stream = GeometryStream::GetInstance();
+	for (int batch = 0; batch < batchCount; batch++)
+	{
+		std::vector<Instance>& instances = batches[batch].instances;
+		const GeometryStream::Allocation allocation = stream.Write(instances.data(), sizeof(Instance) * instances.size());
+
+		glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+		for (int column = 0; column < 3; column++)
+		{
+			glVertexAttribPointer(transformLocation[column], 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(allocation.offset + sizeof(vec3) * column));
+		}
+		glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(allocation.offset + sizeof(vec3) * 3));
+
+		glBindTexture(GL_TEXTURE_2D, batches[batch].texture);
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr, (GLsizei)instances.size());
+
+		instances.clear();
+	}
+
+	glBindVertexArray(0);
+	batchCount = 0;
+}
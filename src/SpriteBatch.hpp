@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+// Draws textured sprites (the quads of textured.vs.glsl) with one instanced draw per texture instead of one draw each.
+// Sprites are queued with Add and drawn on Flush, grouped by texture in the order each texture was first added.
+// A sprite joining a group that is drawn before another one it overlaps flushes first, so sprites that overlap are
+// still drawn in the order they were added. Anything drawn outside the batch has to Flush first too
+class SpriteBatch
+{
+public:
+	SpriteBatch() {}
+
+	// Singleton
+	static SpriteBatch& GetInstance()
+	{
+		static SpriteBatch instance;
+		return instance;
+	}
+
+	// Make sure these functions never get called (or else we may end up with more than 1 SpriteBatch)
+	SpriteBatch(SpriteBatch const &) = delete;
+	void operator=(SpriteBatch const &) = delete;
+
+	// Creates the quad and loads the shader. Should be called once GL functions are loaded
+	bool Init();
+	void Destroy();
+
+	// Projection the sprites added from now on are drawn with
+	void Begin(const mat3& projection);
+
+	// Queues a sprite of the given size (before transform) centered on the origin of transform, tinted by color
+	void Add(GLuint texture, const mat3& transform, vec2 size, const float color[4]);
+
+	// Draws everything queued since the last Flush. Instance data goes through this frame's GeometryStream
+	void Flush();
+
+private:
+	struct Instance
+	{
+		vec3 transform[3];
+		float color[4];
+	};
+
+	struct Batch
+	{
+		GLuint texture = 0;
+		std::vector<Instance> instances;
+
+		// Box around every instance, before projection
+		vec2 boundsMin;
+		vec2 boundsMax;
+	};
+
+	// Index of the queued batch with this texture, batchCount if there is none yet
+	int FindBatch(GLuint texture) const;
+
+private:
+	Mesh quad;
+	Effect effect;
+	mat3 projection;
+
+	GLint projectionLocation = -1;
+	GLint positionLocation = -1;
+	GLint texcoordLocation = -1;
+	GLint transformLocation[3] = { -1, -1, -1 };
+	GLint colorLocation = -1;
+
+	// Batches [0, batchCount) are waiting for Flush, the others only keep their storage
+	std::vector<Batch> batches;
+	int batchCount = 0;
+};
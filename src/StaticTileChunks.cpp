@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include "StaticTileChunks.hpp"
+#include "entity.hpp"
+
+bool StaticTileChunks::Init()
+{
+	if (effect.program != 0)
+	{
+		return true;
+	}
+
+	if (!effect.load_from_file(shader_path("tile_chunk.vs.glsl"), shader_path("sprite.fs.glsl")))
+		return false;
+
+	projectionLocation = glGetUniformLocation(effect.program, "projection");
+	positionLocation = glGetAttribLocation(effect.program, "in_position");
+	texcoordLocation = glGetAttribLocation(effect.program, "in_texcoord");
+	colorLocation = glGetAttribLocation(effect.program, "in_color");
+	return true;
+}
+
+bool StaticTileChunks::Build(const std::vector<Entity*>& entities)
+{
+	Destroy();
+	if (!Init())
+		return false;
+
+	// Tiles of a layer by the chunk they are in, chunks in the order they are first seen
+	std::map<std::pair<int, int>, int> chunkIndices;
+	layerChunks.assign(1, 0);
+	for (Entity* entity : entities)
+	{
+		if (!entity->is_static_tile())
+		{
+			// Tiles after this entity are drawn over it, so they start a new layer
+			if ((int)chunks.size() > layerChunks.back())
+			{
+				layerChunks.push_back((int)chunks.size());
+				chunkIndices.clear();
+			}
+			layersBefore[entity] = GetLayerCount();
+			continue;
+		}
+
+		const vec2 position = entity->get_position();
+		const int chunkSize = CHUNK_TILES * BLOCK_SIZE;
+		const std::pair<int, int> key((int)std::floor(position.x / chunkSize), (int)std::floor(position.y / chunkSize));
+		auto found = chunkIndices.find(key);
+		if (found == chunkIndices.end())
+		{
+			found = chunkIndices.emplace(key, (int)chunks.size()).first;
+			chunks.emplace_back();
+		}
+		chunks[found->second].tiles.push_back(entity);
+	}
+	if ((int)chunks.size() > layerChunks.back())
+	{
+		layerChunks.push_back((int)chunks.size());
+	}
+
+	gl_flush_errors();
+	std::vector<uint16_t> indices;
+	for (Chunk& chunk : chunks)
+	{
+		// Tiles keep their vertices when rebaked, only their order changes, so the indices never do
+		indices.clear();
+		for (int tile = 0; tile < (int)chunk.tiles.size(); tile++)
+		{
+			const uint16_t first = (uint16_t)(tile * 4);
+			const uint16_t quad[] = { 0, 3, 1, 1, 3, 2 };
+			for (uint16_t corner : quad)
+			{
+				indices.push_back(first + corner);
+			}
+		}
+
+		chunk.min = { INFINITY, INFINITY };
+		chunk.max = { -INFINITY, -INFINITY };
+		for (const Entity* tile : chunk.tiles)
+		{
+			const vec2 position = tile->get_position();
+			const vec2 half = tile->get_sprite_half_extent();
+			chunk.min = { std::min(chunk.min.x, position.x - std::fabs(half.x)), std::min(chunk.min.y, position.y - std::fabs(half.y)) };
+			chunk.max = { std::max(chunk.max.x, position.x + std::fabs(half.x)), std::max(chunk.max.y, position.y + std::fabs(half.y)) };
+		}
+
+		glGenVertexArrays(1, &chunk.mesh.vao);
+		glBindVertexArray(chunk.mesh.vao);
+
+		glGenBuffers(1, &chunk.mesh.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.mesh.vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(ChunkVertex) * 4 * chunk.tiles.size(), nullptr, GL_DYNAMIC_DRAW);
+
+		glGenBuffers(1, &chunk.mesh.ibo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.mesh.ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(positionLocation);
+		glEnableVertexAttribArray(texcoordLocation);
+		glEnableVertexAttribArray(colorLocation);
+		glVertexAttribPointer(positionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)0);
+		glVertexAttribPointer(texcoordLocation, 2, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)sizeof(vec3));
+		glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), (void*)(sizeof(vec3) + sizeof(vec2)));
+
+		Bake(chunk);
+	}
+	glBindVertexArray(0);
+
+	return !gl_has_errors();
+}
+
+void StaticTileChunks::Destroy()
+{
+	for (Chunk& chunk : chunks)
+	{
+		glDeleteBuffers(1, &chunk.mesh.vbo);
+		glDeleteBuffers(1, &chunk.mesh.ibo);
+		glDeleteVertexArrays(1, &chunk.mesh.vao);
+	}
+	chunks.clear();
+	layerChunks.assign(1, 0);
+	layersBefore.clear();
+}
+
+int StaticTileChunks::GetLayersBefore(const Entity* entity) const
+{
+	// Entities added after Build go over every tile, like they were at the end of the list
+	auto found = layersBefore.find(entity);
+	return found != layersBefore.end() ? found->second : GetLayerCount();
+}
+
+void StaticTileChunks::Draw(const mat3& projection, vec2 viewPosition, vec2 viewHalfBound, int firstLayer, int lastLayer)
+{
+	const int firstChunk = layerChunks[firstLayer];
+	const int lastChunk = layerChunks[lastLayer];
+	if (firstChunk == lastChunk)
+	{
+		return;
+	}
+
+	glUseProgram(effect.program);
+
+	// Enabling alpha channel for textures
+	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	glUniformMatrix3fv(projectionLocation, 1, GL_FALSE, (float*)&projection);
+	glActiveTexture(GL_TEXTURE0);
+
+	for (int chunkIndex = firstChunk; chunkIndex < lastChunk; chunkIndex++)
+	{
+		Chunk& chunk = chunks[chunkIndex];
+		if (chunk.max.x <= viewPosition.x - viewHalfBound.x || chunk.min.x >= viewPosition.x + viewHalfBound.x ||
+			chunk.max.y <= viewPosition.y - viewHalfBound.y || chunk.min.y >= viewPosition.y + viewHalfBound.y)
+		{
+			continue;
+		}
+
+		glBindVertexArray(chunk.mesh.vao);
+		Update(chunk);
+
+		int firstTile = 0;
+		for (const std::pair<GLuint, int>& run : chunk.runs)
+		{
+			glBindTexture(GL_TEXTURE_2D, run.first);
+			glDrawElements(GL_TRIANGLES, run.second * 6, GL_UNSIGNED_SHORT, (void*)(sizeof(uint16_t) * 6 * firstTile));
+			firstTile += run.second;
+		}
+	}
+	glBindVertexArray(0);
+}
+
+void StaticTileChunks::Update(Chunk& chunk)
+{
+	// A tile changing texture moves to another run, which takes sorting and baking the whole chunk again
+	for (size_t tile = 0; tile < chunk.tiles.size(); tile++)
+	{
+		if (chunk.tiles[tile]->get_sprite_texture()->id != chunk.textures[tile])
+		{
+			Bake(chunk);
+			return;
+		}
+	}
+
+	// Tints change every frame of a fade, only the vertices of the tiles fading are written again
+	int firstChanged = -1;
+	int lastChanged = -1;
+	float tint[4];
+	for (int tile = 0; tile < (int)chunk.tiles.size(); tile++)
+	{
+		chunk.tiles[tile]->get_sprite_tint(tint);
+		if (std::equal(tint, tint + 4, chunk.tints.begin() + tile * 4))
+		{
+			continue;
+		}
+
+		std::copy(tint, tint + 4, chunk.tints.begin() + tile * 4);
+		for (int corner = 0; corner < 4; corner++)
+		{
+			std::copy(tint, tint + 4, chunk.vertices[tile * 4 + corner].color);
+		}
+
+		if (firstChanged == -1)
+		{
+			firstChanged = tile;
+		}
+		lastChanged = tile;
+	}
+
+	if (firstChanged != -1)
+	{
+		const int changedCount = lastChanged - firstChanged + 1;
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.mesh.vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(ChunkVertex) * 4 * firstChanged, sizeof(ChunkVertex) * 4 * changedCount, &chunk.vertices[firstChanged * 4]);
+	}
+}
+
+void StaticTileChunks::Bake(Chunk& chunk)
+{
+	// Tiles of a texture next to each other, so that each texture is drawn once per chunk
+	std::stable_sort(chunk.tiles.begin(), chunk.tiles.end(), [](const Entity* a, const Entity* b)
+	{
+		return a->get_sprite_texture()->id < b->get_sprite_texture()->id;
+	});
+
+	chunk.textures.resize(chunk.tiles.size());
+	chunk.tints.resize(chunk.tiles.size() * 4);
+	chunk.runs.clear();
+	chunk.vertices.clear();
+	for (size_t tile = 0; tile < chunk.tiles.size(); tile++)
+	{
+		const Entity* entity = chunk.tiles[tile];
+		const GLuint texture = entity->get_sprite_texture()->id;
+		chunk.textures[tile] = texture;
+		entity->get_sprite_tint(&chunk.tints[tile * 4]);
+
+		if (chunk.runs.empty() || chunk.runs.back().first != texture)
+		{
+			chunk.runs.emplace_back(texture, 0);
+		}
+		chunk.runs.back().second++;
+
+		// Same corners as the quad Entity::draw_sprite queues, moved to where the tile is
+		const vec2 center = entity->get_position();
+		const vec2 half = entity->get_sprite_half_extent();
+		const vec2 corners[4] = { { -1.f, +1.f }, { +1.f, +1.f }, { +1.f, -1.f }, { -1.f, -1.f } };
+		const vec2 texcoords[4] = { { 0.f, 1.f }, { 1.f, 1.f }, { 1.f, 0.f }, { 0.f, 0.f } };
+		for (int corner = 0; corner < 4; corner++)
+		{
+			ChunkVertex vertex;
+			vertex.position = { center.x + corners[corner].x * half.x, center.y + corners[corner].y * half.y, -0.02f };
+			vertex.texcoord = texcoords[corner];
+			std::copy(chunk.tints.begin() + tile * 4, chunk.tints.begin() + tile * 4 + 4, vertex.color);
+			chunk.vertices.push_back(vertex);
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.mesh.vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ChunkVertex) * chunk.vertices.size(), chunk.vertices.data());
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+
+class Entity;
+
+// Tiles that never move (walls, glass, fog) baked into one mesh per CHUNK_TILES x CHUNK_TILES block of the level,
+// in world space with a tint per vertex, instead of being transformed and drawn one by one every frame.
+// A chunk is only baked again when one of its tiles changed texture. A tint change (lit state and its fade)
+// only rewrites the colors of the tiles it changed.
+// Tiles keep their place in the drawing order: those between two other entities of the list make a layer of chunks,
+// drawn after the entities before them and under those after them
+class StaticTileChunks
+{
+public:
+	static const int CHUNK_TILES = 16;
+
+public:
+	// Bakes the static tiles (Entity::is_static_tile) among entities, replacing the chunks of the previous level
+	bool Build(const std::vector<Entity*>& entities);
+	void Destroy();
+
+	// Draws the chunks of layers [firstLayer, lastLayer) overlapping the view. Those out of it are not baked again
+	// either until they come into view
+	void Draw(const mat3& projection, vec2 viewPosition, vec2 viewHalfBound, int firstLayer, int lastLayer);
+
+	int GetLayerCount() const { return (int)layerChunks.size() - 1; }
+
+	// Layers to draw before an entity that is not a static tile, those of the tiles before it in the list
+	int GetLayersBefore(const Entity* entity) const;
+
+private:
+	struct ChunkVertex
+	{
+		vec3 position;
+		vec2 texcoord;
+		float color[4];
+	};
+
+	struct Chunk
+	{
+		Mesh mesh;
+
+		// Box around every quad of the chunk
+		vec2 min;
+		vec2 max;
+
+		// Tiles in the order they were last baked, by texture, with the texture and tint they were baked with
+		std::vector<Entity*> tiles;
+		std::vector<GLuint> textures;
+		std::vector<float> tints;
+
+		// Consecutive tiles sharing a texture, drawn together
+		std::vector<std::pair<GLuint, int>> runs;
+
+		// What is in the vertex buffer, 4 vertices per tile, kept to rewrite the tints in place
+		std::vector<ChunkVertex> vertices;
+	};
+
+	bool Init();
+
+	// Brings the chunk up to date with its tiles, baking it again only if one of them changed texture
+	static void Update(Chunk& chunk);
+
+	static void Bake(Chunk& chunk);
+
+private:
+	Effect effect;
+	GLint projectionLocation = -1;
+	GLint positionLocation = -1;
+	GLint texcoordLocation = -1;
+	GLint colorLocation = -1;
+
+	std::vector<Chunk> chunks;
+
+	// Chunks [layerChunks[layer], layerChunks[layer + 1]) make the layer
+	std::vector<int> layerChunks;
+	std::unordered_map<const Entity*, int> layersBefore;
+};
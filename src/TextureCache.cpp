@@ -0,0 +1,92 @@
+#include "TextureCache.hpp"
+#include "../ext/stb_image/stb_image.h"
+
+const TextureCache::Entry* TextureCache::Borrow(const char* path)
+{
+	auto found = entries.find(path);
+	if (found == entries.end())
+	{
+		Entry entry;
+		if (!Load(path, entry))
+		{
+			return nullptr;
+		}
+		found = entries.emplace(path, entry).first;
+		pathsById[entry.id] = path;
+
+		stats.misses++;
+		stats.textureCount++;
+		stats.residentBytes += Size(entry);
+	}
+	else
+	{
+		stats.hits++;
+		if (found->second.refCount == 0)
+		{
+			stats.unborrowedCount--;
+			stats.unborrowedBytes -= Size(found->second);
+		}
+	}
+
+	found->second.refCount++;
+	return &found->second;
+}
+
+void TextureCache::Return(GLuint id)
+{
+	auto path = pathsById.find(id);
+	if (path == pathsById.end())
+	{
+		return;
+	}
+
+	Entry& entry = entries[path->second];
+	entry.refCount--;
+	if (entry.refCount == 0)
+	{
+		stats.unborrowedCount++;
+		stats.unborrowedBytes += Size(entry);
+	}
+}
+
+void TextureCache::Destroy()
+{
+	for (const auto& entry : entries)
+	{
+		glDeleteTextures(1, &entry.second.id);
+	}
+	entries.clear();
+	pathsById.clear();
+
+	stats.textureCount = 0;
+	stats.residentBytes = 0;
+	stats.unborrowedCount = 0;
+	stats.unborrowedBytes = 0;
+}
+
+size_t TextureCache::Size(const Entry& entry)
+{
+	return (size_t)entry.width * entry.height * 4;
+}
+
+bool TextureCache::Load(const char* path, Entry& outEntry)
+{
+	stbi_uc* data = stbi_load(path, &outEntry.width, &outEntry.height, NULL, 4);
+	if (data == NULL)
+		return false;
+
+	gl_flush_errors();
+	glGenTextures(1, &outEntry.id);
+	glBindTexture(GL_TEXTURE_2D, outEntry.id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, outEntry.width, outEntry.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	stbi_image_free(data);
+
+	if (gl_has_errors())
+	{
+		glDeleteTextures(1, &outEntry.id);
+		return false;
+	}
+	return true;
+}
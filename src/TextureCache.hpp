@@ -0,0 +1,65 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "common.hpp"
+
+// Every Texture loading the same image file shares one GL texture, so each image is decoded once per process.
+// Textures are reference counted by those borrowing them. One that is no longer borrowed is still kept until
+// Destroy, so that reloading a level finds the images its entities need already uploaded, and counted in the unborrowed stats
+class TextureCache
+{
+public:
+	struct Entry
+	{
+		GLuint id = 0;
+		int width = 0;
+		int height = 0;
+		int refCount = 0;
+	};
+
+	// Usage since the process started, for keeping an eye on texture memory
+	struct Stats
+	{
+		int hits = 0;				// Borrows that found the image already loaded
+		int misses = 0;				// Borrows that had to decode it
+		int textureCount = 0;		// Images currently loaded, borrowed or not
+		size_t residentBytes = 0;	// Their size on the GPU, without mipmaps or driver padding
+		int unborrowedCount = 0;	// Images loaded that no Texture uses right now, kept for the next level
+		size_t unborrowedBytes = 0;	// Their size on the GPU
+	};
+
+public:
+	TextureCache() {}
+
+	// Singleton
+	static TextureCache& GetInstance()
+	{
+		static TextureCache instance;
+		return instance;
+	}
+
+	// Make sure these functions never get called (or else we may end up with more than 1 TextureCache)
+	TextureCache(TextureCache const &) = delete;
+	void operator=(TextureCache const &) = delete;
+
+	// Texture of this image file, decoded and uploaded if no one has it yet. nullptr if it could not be loaded
+	const Entry* Borrow(const char* path);
+
+	// Gives back a texture obtained from Borrow
+	void Return(GLuint id);
+
+	// Deletes every texture, borrowed or not. Should be called before the GL context goes away
+	void Destroy();
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	static bool Load(const char* path, Entry& outEntry);
+	static size_t Size(const Entry& entry);
+
+private:
+	std::map<std::string, Entry> entries;
+	std::map<GLuint, std::string> pathsById;
+	Stats stats;
+};
@@ -0,0 +1,151 @@
+#include <cmath>
+#include <algorithm>
+#include "VisibilitySweep.hpp"
+
+namespace
+{
+	// Angles are only compared, pseudo angles (see pseudo_angle) keep their order for a fraction of the cost
+	const float HALF_TURN = 2.f;
+
+	// Angle around the light, the same way RadiusLightMesh measures it (y points down)
+	float AngleOf(float x, float y)
+	{
+		return pseudo_angle({ x, -y });
+	}
+
+	float Cross(vec2 a, vec2 b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+}
+
+void VisibilitySweep::Compute(const ParametricLines& segments, const std::vector<vec2>& points, std::vector<vec2>& outHits)
+{
+	sweptSegments = &segments;
+	outHits.assign(points.begin(), points.end());
+	events.clear();
+
+	// Segments crossing angle 0 are already under the sweep ray when it starts
+	std::vector<int> activeAtStart;
+	for (int i = 0; i < (int)segments.size(); i++)
+	{
+		const ParametricLine& line = segments[i];
+		vec2 start = { line.x_0, line.y_0 };
+		vec2 end = { line.x_0 + line.x_t, line.y_0 + line.y_t };
+		float startAngle = AngleOf(start.x, start.y);
+		float endAngle = AngleOf(end.x, end.y);
+
+		// A segment covers the shorter way around between its endpoints
+		float span = endAngle - startAngle;
+		if (span > HALF_TURN)
+		{
+			span -= 2 * HALF_TURN;
+		}
+		else if (span <= -HALF_TURN)
+		{
+			span += 2 * HALF_TURN;
+		}
+		if (span < 0.f)
+		{
+			std::swap(startAngle, endAngle);
+			std::swap(start, end);
+		}
+
+		// Segments pointing straight at the light can only be hit edge on, which the ray test does not count either
+		if (span == 0.f)
+		{
+			continue;
+		}
+
+		events.push_back({ startAngle, start, SEGMENT_START, i });
+		events.push_back({ endAngle, end, SEGMENT_END, i });
+		if (startAngle > endAngle)
+		{
+			activeAtStart.push_back(i);
+		}
+	}
+
+	for (int i = 0; i < (int)points.size(); i++)
+	{
+		events.push_back({ AngleOf(points[i].x, points[i].y), points[i], QUERY, i });
+	}
+
+	std::sort(events.begin(), events.end(), [](const Event& event1, const Event& event2)
+	{
+		if (event1.angle != event2.angle)
+		{
+			return event1.angle < event2.angle;
+		}
+		return event1.type < event2.type;
+	});
+
+	// Segments under the sweep ray, in no particular order. Each query looks for the nearest of them at its own angle,
+	// so nothing depends on an order that would change as the ray turns
+	activeSegments.clear();
+	activeIndices.assign(segments.size(), -1);
+
+	for (int segment : activeAtStart)
+	{
+		activeIndices[segment] = (int)activeSegments.size();
+		activeSegments.push_back(segment);
+	}
+
+	for (const Event& event : events)
+	{
+		if (event.type == SEGMENT_START)
+		{
+			if (activeIndices[event.index] < 0)
+			{
+				activeIndices[event.index] = (int)activeSegments.size();
+				activeSegments.push_back(event.index);
+			}
+		}
+		else if (event.type == SEGMENT_END)
+		{
+			// Swapped with the last one, which takes its place in the list
+			const int index = activeIndices[event.index];
+			if (index >= 0)
+			{
+				const int last = activeSegments.back();
+				activeSegments[index] = last;
+				activeIndices[last] = index;
+				activeSegments.pop_back();
+				activeIndices[event.index] = -1;
+			}
+		}
+		else if (!activeSegments.empty())
+		{
+			// Segments meeting under the ray are hit at the same point, whichever of them is taken
+			const vec2 point = points[event.index];
+			float time = INFINITY;
+			for (int segment : activeSegments)
+			{
+				const float distance = DistanceAlong(segment, point);
+				if (distance >= 0.f)
+				{
+					time = std::min(time, distance);
+				}
+			}
+			if (time < 1.f)
+			{
+				outHits[event.index] = point * time;
+			}
+		}
+	}
+}
+
+float VisibilitySweep::DistanceAlong(int segment, vec2 direction) const
+{
+	const ParametricLine& line = (*sweptSegments)[segment];
+	const vec2 start = { line.x_0, line.y_0 };
+	const vec2 delta = { line.x_t, line.y_t };
+
+	const float denominator = Cross(direction, delta);
+	if (denominator == 0.f)
+	{
+		// Looking along the segment, its nearest endpoint is what we would hit
+		const vec2 end = { line.x_0 + line.x_t, line.y_0 + line.y_t };
+		return std::min(start.Magnitude(), end.Magnitude()) / direction.Magnitude();
+	}
+	return Cross(start, delta) / denominator;
+}
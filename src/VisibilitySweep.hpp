@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+// Visibility from a point light: segment endpoints and query rays are sorted by angle and swept once,
+// so that each query ray is only tested against the segments it crosses, not against every segment.
+// Gives the same hits as casting each query ray against every segment
+class VisibilitySweep
+{
+public:
+	// For each point, where the ray from (0, 0) to it first hits a segment, or the point itself if nothing is in the way.
+	// Segments are relative to the light. outHits[i] is the hit for points[i]
+	void Compute(const ParametricLines& segments, const std::vector<vec2>& points, std::vector<vec2>& outHits);
+
+private:
+	enum EventType
+	{
+		SEGMENT_START = 0,	// At the same angle, segments start before queries and end after them, like the inclusive ray test
+		QUERY = 1,
+		SEGMENT_END = 2,
+	};
+
+	struct Event
+	{
+		float angle;
+		vec2 direction;		// Any point at that angle, so that the sweep ray does not need cos/sin
+		EventType type;
+		int index;			// Segment or point index
+	};
+
+	// Distance to a segment along a direction, in units of the direction's length
+	float DistanceAlong(int segment, vec2 direction) const;
+
+private:
+	const ParametricLines* sweptSegments = nullptr;
+
+	std::vector<Event> events;
+
+	// Segments under the sweep ray, and where each segment is in that list (-1 when it is not)
+	std::vector<int> activeSegments;
+	std::vector<int> activeIndices;
+};
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(int workerCount)
+	: nextJob(0)
+{
+	if (workerCount < 0)
+	{
+		// hardware_concurrency may not know, and returns 0 then
+		workerCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+	}
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// Not worth waking anyone for a single job
+	if (workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		batchJob = &job;
+		batchCount = count;
+		batchId++;
+		busyWorkers = (int)workers.size();
+		nextJob = 0;
+	}
+	workReady.notify_all();
+
+	RunJobs(job, count);
+
+	// job lives on our caller's stack, every worker has to be done with it before returning
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return busyWorkers == 0; });
+	batchJob = nullptr;
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned int lastBatchId = 0;
+	while (true)
+	{
+		const std::function<void(int)>* job;
+		int count;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [this, lastBatchId] { return stopping || batchId != lastBatchId; });
+			if (stopping)
+			{
+				return;
+			}
+
+			lastBatchId = batchId;
+			job = batchJob;
+			count = batchCount;
+		}
+
+		RunJobs(*job, count);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+		{
+			workDone.notify_one();
+		}
+	}
+}
+
+void WorkerPool::RunJobs(const std::function<void(int)>& job, int count)
+{
+	for (int i = nextJob++; i < count; i = nextJob++)
+	{
+		job(i);
+	}
+}
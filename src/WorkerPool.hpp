@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting independent CPU work (e.g. one light polygon per job) across cores.
+// The thread calling ParallelFor works on jobs too, and gets them all if the pool has no workers
+class WorkerPool
+{
+public:
+	// One worker per core besides the calling thread when workerCount is negative
+	explicit WorkerPool(int workerCount = -1);
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const &) = delete;
+	void operator=(WorkerPool const &) = delete;
+
+	// Calls job(i) for every i in [0, count) and returns once they have all finished.
+	// Jobs run concurrently, in no particular order
+	void ParallelFor(int count, const std::function<void(int)>& job);
+
+	int GetWorkerCount() const { return (int)workers.size(); }
+
+private:
+	void WorkerLoop();
+
+	// Takes job indices until there are none left
+	void RunJobs(const std::function<void(int)>& job, int count);
+
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+
+	// Current batch, handed to the workers whenever batchId changes
+	const std::function<void(int)>* batchJob = nullptr;
+	int batchCount = 0;
+	unsigned int batchId = 0;
+	int busyWorkers = 0;
+	bool stopping = false;
+
+	std::atomic<int> nextJob;
+};
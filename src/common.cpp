@@ -1,4 +1,6 @@
 #include "common.hpp"
+#include "ShaderCache.hpp"
+#include "TextureCache.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../ext/stb_image/stb_image.h"
@@ -87,36 +89,52 @@ vec2 normalize(vec2 v)
 
 Texture::Texture()
 {
-
+	// Textures give theirs back to the cache when destroyed, static ones included, so it has to be there first
+	TextureCache::GetInstance();
 }
 
 Texture::~Texture()
 {
-	if (id != 0) glDeleteTextures(1, &id);
-	if (depth_render_buffer_id != 0) glDeleteRenderbuffers(1, &depth_render_buffer_id);
+	release();
 }
 
 bool Texture::load_from_file(const char* path)
 {
 	if (path == nullptr) 
 		return false;
-	
-	stbi_uc* data = stbi_load(path, &width, &height, NULL, 4);
-	if (data == NULL)
+
+	// Textures loading the same file share one GL texture, only the first of them decodes it
+	release();
+	const TextureCache::Entry* shared = TextureCache::GetInstance().Borrow(path);
+	if (shared == nullptr)
 		return false;
 
-	gl_flush_errors();
-	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	stbi_image_free(data);
-	return !gl_has_errors();
+	id = shared->id;
+	width = shared->width;
+	height = shared->height;
+	is_shared = true;
+	return true;
+}
+
+void Texture::release()
+{
+	if (is_shared)
+	{
+		TextureCache::GetInstance().Return(id);
+	}
+	else
+	{
+		if (id != 0) glDeleteTextures(1, &id);
+		if (depth_render_buffer_id != 0) glDeleteRenderbuffers(1, &depth_render_buffer_id);
+	}
+	id = 0;
+	depth_render_buffer_id = 0;
+	is_shared = false;
 }
 
 // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
 bool Texture::create_from_screen(GLFWwindow const * const window) {
+	release();
 	gl_flush_errors();
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);
@@ -151,106 +169,28 @@ bool Texture::is_valid()const
 	return id != 0;
 }
 
-namespace
-{
-	bool gl_compile_shader(GLuint shader)
-	{
-		glCompileShader(shader);
-		GLint success = 0;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-		if (success == GL_FALSE)
-		{
-			GLint log_len;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_len);
-			std::vector<char> log(log_len);
-			glGetShaderInfoLog(shader, log_len, &log_len, log.data());
-			glDeleteShader(shader);
-
-			fprintf(stderr, "GLSL: %s", log.data());
-			return false;
-		}
-
-		return true;
-	}
-}
-
 bool Effect::load_from_file(const char* vs_path, const char* fs_path)
 {
-	gl_flush_errors();
-
-	// Opening files
-	std::ifstream vs_is(vs_path);
-	std::ifstream fs_is(fs_path);
-
-	if (!vs_is.good() || !fs_is.good())
-	{
-		fprintf(stderr, "Failed to load shader files %s, %s", vs_path, fs_path);
-		return false;
-	}
-
-	// Reading sources
-	std::stringstream vs_ss, fs_ss;
-	vs_ss << vs_is.rdbuf();
-	fs_ss << fs_is.rdbuf();
-	std::string vs_str = vs_ss.str();
-	std::string fs_str = fs_ss.str();
-	const char* vs_src = vs_str.c_str();
-	const char* fs_src = fs_str.c_str();
-	GLsizei vs_len = (GLsizei)vs_str.size();
-	GLsizei fs_len = (GLsizei)fs_str.size();
-
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vs_src, &vs_len);
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fs_src, &fs_len);
-
-	// Compiling
-	// Shaders already delete if compilation fails
-	if (!gl_compile_shader(vertex))
-		return false;
-
-	if (!gl_compile_shader(fragment))
-	{
-		glDeleteShader(vertex);
-		return false;
-	}
-
-	// Linking
-	program = glCreateProgram();
-	glAttachShader(program, vertex);
-	glAttachShader(program, fragment);
-	glLinkProgram(program);
-	{
-		GLint is_linked = 0;
-		glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
-		if (is_linked == GL_FALSE)
-		{
-			GLint log_len;
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_len);
-			std::vector<char> log(log_len);
-			glGetProgramInfoLog(program, log_len, &log_len, log.data());
-
-			release();
-			fprintf(stderr, "Link error: %s", log.data());
-			return false;
-		}
-	}
-
-	if (gl_has_errors())
+	// Effects loading the same files share one program, only the first of them compiles it
+	release();
+	const ShaderCache::Program* shared = ShaderCache::GetInstance().Borrow(vs_path, fs_path);
+	if (shared == nullptr)
 	{
-		release();
-		fprintf(stderr, "OpenGL errors occured while compiling Effect");
 		return false;
 	}
 
+	vertex = shared->vertex;
+	fragment = shared->fragment;
+	program = shared->program;
 	return true;
 }
 
 void Effect::release()
 {
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-	glDeleteProgram(program);
+	// The program stays in the ShaderCache for the next Effect loading the same files
+	vertex = 0;
+	fragment = 0;
+	program = 0;
 }
 
 void Renderable::transform_begin()
@@ -25,6 +25,9 @@
 #define levels_path(name) data_path "/levels/" name
 #define fonts_path(name) data_path "/fonts/" name
 
+// Size in pixels of a single level tile
+#define BLOCK_SIZE 64
+
 // Not much math is needed and there are already way too many libraries linked (:
 // If you want to do some overloads..
 struct vec2
@@ -77,6 +80,18 @@ float dot(vec3 l, vec3 r);
 mat3  mul(const mat3& l, const mat3& r);
 vec2  normalize(vec2 v);
 
+// Stand-in for the angle of v (atan2(v.y, v.x) taken in [0, 2 PI)) when it is only compared, without any trigonometry.
+// Goes from 0 to 4 with the angle, a quarter turn per unit, and opposite directions are always 2 apart. 0 for the zero vector
+inline float pseudo_angle(vec2 v)
+{
+	// Position along the diamond |x| + |y| = 1, one quadrant at a time
+	if (v.x == 0.f && v.y == 0.f)
+		return 0.f;
+	if (v.y >= 0.f)
+		return v.x >= 0.f ? v.y / (v.x + v.y) : 1.f - v.x / (v.y - v.x);
+	return v.x < 0.f ? 2.f - v.y / (-v.x - v.y) : 3.f + v.x / (v.x - v.y);
+}
+
 // OpenGL utilities
 // cleans error buffer
 void gl_flush_errors();
@@ -102,16 +117,22 @@ struct Texture
 	Texture();
 	~Texture();
 
-	GLuint id;
-	GLuint depth_render_buffer_id;
-	int width;
-	int height;
+	GLuint id = 0;
+	GLuint depth_render_buffer_id = 0;
+	int width = 0;
+	int height = 0;
 	
-	// Loads texture from file specified by path
+	// Loads texture from file specified by path, shared through the TextureCache with every texture loading it
 	bool load_from_file(const char* path);
 	// Screen texture
 	bool create_from_screen(GLFWwindow const * const window);
 	bool is_valid()const; // True if texture is valid
+
+	// Gives back a shared texture, or deletes a screen one
+	void release();
+
+private:
+	bool is_shared = false;
 };
 
 // A Mesh is a collection of a VertexBuffer and an IndexBuffer. A VAO
@@ -119,21 +140,22 @@ struct Texture
 // an Index Buffer
 struct Mesh
 {
-	GLuint vao;
-	GLuint vbo;
-	GLuint ibo;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ibo = 0;
 };
 
 // Container for Vertex and Fragment shader, which are then put(linked) together in a
 // single program that is then bound to the pipeline.
+// The program is borrowed from the ShaderCache, and shared with every other Effect loading the same files
 struct Effect
 {
 	bool load_from_file(const char* vs_path, const char* fs_path);
 	void release();
 
-	GLuint vertex;
-	GLuint fragment;
-	GLuint program;
+	GLuint vertex = 0;
+	GLuint fragment = 0;
+	GLuint program = 0;
 };
 
 // Helper container for all the information we need when rendering an object together
@@ -171,13 +193,6 @@ struct ParametricLine
 
 typedef std::vector<ParametricLine> ParametricLines;
 
-struct EntityLines
-{
-	class Entity* entity;
-	ParametricLines boundaryLines;
-	ParametricLines lightCollisionLines;
-};
-
 enum StaticTile
 {
 	WALL,
@@ -22,10 +22,10 @@ public:
 
 	bool alwaysRender() override { return true; }
 	bool activated_by_light() const override { return false; }
+	bool is_player_trigger() const override { return true; }
 
 	const char* get_audio_path() const override { return audio_path("open_door.wav"); }
 
-    bool is_player_inside(Player* player_pos);
 	int get_level_index();
 	void set_level_index(int);
 
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <iostream>
 #include "CollisionManager.hpp"
+#include "SpriteBatch.hpp"
 
 
 bool Entity::init(float x_pos, float y_pos) {
@@ -18,44 +19,8 @@ bool Entity::init(float x_pos, float y_pos) {
 
 	texture = m_is_lit ? &lit_texture : &unlit_texture;
 
-	// The position corresponds to the center of the texture
-	float wr = texture->width * 0.5f;
-	float hr = texture->height * 0.5f;
-
-	TexturedVertex vertices[4];
-	vertices[0].position = { -wr, +hr, -0.02f };
-	vertices[0].texcoord = { 0.f, 1.f };
-	vertices[1].position = { +wr, +hr, -0.02f };
-	vertices[1].texcoord = { 1.f, 1.f };
-	vertices[2].position = { +wr, -hr, -0.02f };
-	vertices[2].texcoord = { 1.f, 0.f };
-	vertices[3].position = { -wr, -hr, -0.02f };
-	vertices[3].texcoord = { 0.f, 0.f };
-
-	// counterclockwise as it's the default opengl front winding direction
-	uint16_t indices[] = { 0, 3, 1, 1, 3, 2 };
-
-	// Clearing errors
-	gl_flush_errors();
-
-	// Vertex Buffer creation
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * 4, vertices, GL_STATIC_DRAW);
-
-	// Index Buffer creation
-	glGenBuffers(1, &mesh.ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices, GL_STATIC_DRAW);
-
-	// Vertex Array (Container for Vertex + Index buffer)
-	glGenVertexArrays(1, &mesh.vao);
-	if (gl_has_errors())
-		return false;
-
-	// Loading shaders
-	if (!effect.load_from_file(shader_path("textured.vs.glsl"), shader_path("textured.fs.glsl")))
-		return false;
+	// Drawn by the SpriteBatch, as big as the texture we start with
+	m_sprite_size = { (float)texture->width, (float)texture->height };
 
 	// Setting initial values, scale is negative to make it face the opposite way
 	// 1.0 would be as big as the original texture
@@ -84,14 +49,9 @@ bool Entity::init(float x_pos, float y_pos) {
 void Entity::destroy() {
 	CollisionManager::GetInstance().UnregisterEntity(this);
 
-	glDeleteBuffers(1, &mesh.vbo);
-	glDeleteBuffers(1, &mesh.ibo);
-	glDeleteVertexArrays(1, &mesh.vao);
-
+	// Sprites are drawn by the SpriteBatch, there is no mesh or effect of our own to release
 	if (m_entity_sound != nullptr)
 		Mix_FreeChunk(m_entity_sound);
-
-	effect.release();
 }
 
 void Entity::UpdateHitByLight()
@@ -128,8 +88,11 @@ void Entity::update(float elapsed_ms) {
 	}
 }
 
-void Entity::draw(const mat3& projection) {
+void Entity::draw(const mat3& /*projection*/) {
+	draw_sprite(texture, 1.f);
+}
 
+void Entity::draw_sprite(const Texture* sprite_texture, float opacity) {
 	// Transformation code, see Rendering and Transformation in the template specification for more info
 	// Incrementally updates transformation matrix, thus ORDER IS IMPORTANT
 	transform_begin();
@@ -137,45 +100,24 @@ void Entity::draw(const mat3& projection) {
 	transform_scale(m_scale);
 	transform_end();
 
-	// Setting shaders
-	glUseProgram(effect.program);
-
-	// Enabling alpha channel for textures
-	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-
-	// Getting uniform locations for glUniform* calls
-	GLint transform_uloc = glGetUniformLocation(effect.program, "transform");
-	GLint color_uloc = glGetUniformLocation(effect.program, "fcolor");
-	GLint projection_uloc = glGetUniformLocation(effect.program, "projection");
-
-	// Setting vertices and indices
-	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-	// Input data location as in the vertex buffer
-	GLint in_position_loc = glGetAttribLocation(effect.program, "in_position");
-	GLint in_texcoord_loc = glGetAttribLocation(effect.program, "in_texcoord");
-	glEnableVertexAttribArray(in_position_loc);
-	glEnableVertexAttribArray(in_texcoord_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
-	glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
-
-	// Enabling and binding texture to slot 0
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture->id);
-
-	// Setting uniform values to the currently bound program
-	glUniformMatrix3fv(transform_uloc, 1, GL_FALSE, (float*)&transform);
-	EntityColor color = get_color();
-	float fvColor[4] = { color.r*darkness_modifier, color.g*darkness_modifier, color.b*darkness_modifier, color.a };
+	float fvColor[4];
+	get_sprite_tint(fvColor);
+	fvColor[3] *= opacity;
 
-	glUniform4fv(color_uloc, 1, fvColor);
-	glUniformMatrix3fv(projection_uloc, 1, GL_FALSE, (float*)&projection);
+	// Queued, the SpriteBatch draws every sprite of a texture at once
+	SpriteBatch::GetInstance().Add(sprite_texture->id, transform, m_sprite_size, fvColor);
+}
+
+void Entity::get_sprite_tint(float outColor[4]) const {
+	EntityColor color = get_color();
+	outColor[0] = color.r*darkness_modifier;
+	outColor[1] = color.g*darkness_modifier;
+	outColor[2] = color.b*darkness_modifier;
+	outColor[3] = color.a;
+}
 
-	// Drawing!
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
+vec2 Entity::get_sprite_half_extent() const {
+	return { m_sprite_size.x * m_scale.x * 0.5f, m_sprite_size.y * m_scale.y * 0.5f };
 }
 
 vec2 Entity::get_position() const {
@@ -184,6 +126,7 @@ vec2 Entity::get_position() const {
 
 void Entity::set_position(vec2 position) {
 	m_position = position;
+	CollisionManager::GetInstance().UpdateEntity(this);
 }
 
 // Returns the local bounding coordinates scaled by the current size of the entity
@@ -201,7 +144,14 @@ ParametricLines Entity::calculate_static_equations() const {
 
 void Entity::set_lit(bool lit) {
 	m_is_lit = lit;
+
+	Texture* previousTexture = texture;
 	texture = lit ? &lit_texture : &unlit_texture;
+
+	// Lit and unlit textures can differ in size, which changes our bounding box
+	if (texture != previousTexture) {
+		CollisionManager::GetInstance().UpdateEntity(this);
+	}
 }
 
 bool Entity::get_lit() const {
@@ -24,7 +24,12 @@ public:
 	virtual bool is_player_collidable() const { return false; }
 	virtual bool is_light_collidable() const { return false; }
 	virtual bool is_light_dynamic() const { return false; }
+	virtual bool is_player_trigger() const { return false; }
 	virtual bool activated_by_light() const { return true; }
+	// Being lit does more than change how we look, so the lights reaching us are computed even when off screen
+	virtual bool lit_changes_gameplay() const { return false; }
+	// Never moves once the level is created, drawn as part of a StaticTileChunks mesh instead of by draw
+	virtual bool is_static_tile() const { return false; }
 	virtual EntityColor get_color() const { return EntityColor({1.0, 1.0, 1.0, 1.0}); }
 
 	virtual void activate() {};
@@ -42,10 +47,16 @@ public:
 	virtual void update(float elapsed_ms);
 	void UpdateHitByLight();
 
-	// Renders the entity using the texture
+	// Renders the entity using the texture, through the SpriteBatch
 	virtual void draw(const mat3& projection) override;
 	virtual void predraw() {};
 
+	// Radius light to compute this frame, if the entity gives off one. World computes them all together before drawing
+	virtual RadiusLightMesh* prepare_light() { return nullptr; }
+
+	// How far past its bounding box draw can reach (e.g. the light of a firefly), for culling
+	virtual float get_draw_reach() const { return 0.f; }
+
 	// Returns the current entity position
 	vec2 get_position() const;
 
@@ -63,6 +74,11 @@ public:
 	void set_lit(bool lit);
 	bool get_lit() const;
 
+	// What draw queues: the current texture, its tint (darkened by how lit we are) and half the size of the quad in world space
+	const Texture* get_sprite_texture() const { return texture; }
+	void get_sprite_tint(float outColor[4]) const;
+	vec2 get_sprite_half_extent() const;
+
 	// Register an entity relationship
 	void register_entity(Entity* entity);
 
@@ -83,6 +99,12 @@ protected:
 
 	float darkness_modifier;
 
+	// Size of the sprite before m_scale, set from the texture by init
+	vec2 m_sprite_size;
+
+	// Queues our sprite with the given texture, darkened by how lit we are and faded by opacity
+	void draw_sprite(const Texture* sprite_texture, float opacity);
+
     // 1.f in each dimension. 1.f is as big as the associated texture
     vec2 m_scale;
     vec2 m_position;
@@ -1,5 +1,6 @@
 #include "firefly.hpp"
 #include "CollisionManager.hpp"
+#include "SpriteBatch.hpp"
 #include <random>
 
 #define PI 3.14159265
@@ -101,6 +102,9 @@ void Firefly::SingleFirefly::update(float ms, std::vector<SingleFirefly>& firefl
 
 void Firefly::SingleFirefly::draw(const mat3& projection)
 {
+	// Drawn over the sprites queued before us
+	SpriteBatch::GetInstance().Flush();
+
 	transform_begin();
 
 	// see Transformations and Rendering in the specification pdf
@@ -239,10 +243,34 @@ void Firefly::update(float ms)
             m_velocity.x += fmin(fabs(m_velocity.x), VELOCITY_SLOWING_STEP * (ms / 100)) * ((m_velocity.x < 0) ? 1 : -1);
 		}
 	}
-	float xDist = m_velocity.x * ms;
-	float yDist = m_velocity.y * ms;
+	m_pending_move = { m_velocity.x * ms, m_velocity.y * ms };
+	m_has_pending_move = true;
+
+	for (SingleFirefly& firefly : fireflies)
+	{
+		firefly.update(ms, fireflies);
+	}
+}
+
+bool Firefly::get_trace_request(CollisionManager::TraceRequest& outRequest) const
+{
+	if (!m_has_pending_move)
+	{
+		return false;
+	}
 
-	CollisionManager::CollisionResult collisionResult = CollisionManager::GetInstance().BoxTrace(10, 10, m_position.x, m_position.y, xDist, yDist);
+	outRequest.width = 10;
+	outRequest.height = 10;
+	outRequest.xPos = m_position.x;
+	outRequest.yPos = m_position.y;
+	outRequest.xDist = m_pending_move.x;
+	outRequest.yDist = m_pending_move.y;
+	return true;
+}
+
+void Firefly::apply_trace_result(const CollisionManager::CollisionResult& collisionResult)
+{
+	m_has_pending_move = false;
 
 	m_position.x = collisionResult.resultXPos;
 	m_position.y = collisionResult.resultYPos;
@@ -252,11 +280,6 @@ void Firefly::update(float ms)
 		m_velocity.y = 0.f;
 	}
 	//TODO eventually also check for hits on X direction and set m_vel.x to 0 if they happen
-
-	for (SingleFirefly& firefly : fireflies)
-	{
-		firefly.update(ms, fireflies);
-	}
 }
 
 void Firefly::draw(const mat3& projection)
@@ -273,10 +296,10 @@ void Firefly::draw(const mat3& projection)
 	lightMesh.draw(projection);
 }
 
-void Firefly::predraw()
+RadiusLightMesh* Firefly::prepare_light()
 {
 	RadiusLightMesh::ParentData lightData;
 	lightData.m_position = m_position;
 	lightMesh.SetParentData(lightData);
-	lightMesh.predraw();
+	return &lightMesh;
 }
@@ -3,6 +3,7 @@
 #include <common.hpp>
 #include <radiuslight_mesh.hpp>
 #include "entity.hpp"
+#include "CollisionManager.hpp"
 
 class Firefly : public Entity {
 
@@ -54,8 +55,15 @@ public:
 	void update(float ms) override;
 
 	void draw(const mat3& projection) override;
-	void predraw() override;
+	RadiusLightMesh* prepare_light() override;
+	float get_draw_reach() const override { return lightMesh.getLightRadius(); }
+
+	// Moves are traced by World together with the other fireflies' once every entity has updated
+	bool get_trace_request(CollisionManager::TraceRequest& outRequest) const;
+	void apply_trace_result(const CollisionManager::CollisionResult& collisionResult);
 
 private:
     vec2 m_velocity;
+    vec2 m_pending_move;
+    bool m_has_pending_move = false;
 };
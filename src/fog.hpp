@@ -20,6 +20,7 @@ public:
     const char* get_texture_path() const override { return textures_path("fog.png"); }
     bool is_light_collidable() const override { return true; }
 	bool is_light_dynamic() const override { return true; }
+	bool is_static_tile() const override { return true; }
 
 	ParametricLines calculate_static_equations() const override { return ParametricLines(); };
 	ParametricLines calculate_dynamic_equations() const override;
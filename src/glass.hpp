@@ -6,4 +6,5 @@ class Glass : public Entity {
 public:
 	const char* get_texture_path() const override { return textures_path("glass.png"); }
 	bool is_player_collidable() const override { return true; }
+	bool is_static_tile() const override { return true; }
 };
@@ -7,29 +7,8 @@ void Hint::set_hint_path(const std::string &hint_path) {
         fprintf(stderr, "Failed to load hint texture!");
     }
     texture = &lit_texture;
+    CollisionManager::GetInstance().UpdateEntity(this);
 
-    // Resize and reposition texture
-    float wr = texture->width;
-    float hr = texture->height;
-
-    TexturedVertex vertices[4];
-    vertices[0].position = { -wr, +hr, -0.02f };
-    vertices[0].texcoord = { 0.f, 1.f };
-    vertices[1].position = { +wr, +hr, -0.02f };
-    vertices[1].texcoord = { 1.f, 1.f };
-    vertices[2].position = { +wr, -hr, -0.02f };
-    vertices[2].texcoord = { 1.f, 0.f };
-    vertices[3].position = { -wr, -hr, -0.02f };
-    vertices[3].texcoord = { 0.f, 0.f };
-
-    // counterclockwise as it's the default opengl front winding direction
-    uint16_t indices[] = { 0, 3, 1, 1, 3, 2 };
-
-    // Clearing errors
-    gl_flush_errors();
-
-    // Vertex Buffer creation
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * 4, vertices, GL_STATIC_DRAW);
+    // Drawn twice as big as the texture
+    m_sprite_size = { texture->width * 2.f, texture->height * 2.f };
 }
\ No newline at end of file
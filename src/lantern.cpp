@@ -70,10 +70,11 @@ void Lantern::deactivate() {
     set_on(false);
 }
 
-void Lantern::predraw() {
+RadiusLightMesh* Lantern::prepare_light() {
     if (get_on()) {
-        Firefly::predraw();
+        return Firefly::prepare_light();
     }
+    return nullptr;
 }
 
 bool Lantern::get_on() {
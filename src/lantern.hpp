@@ -20,7 +20,7 @@ public:
 
     void update(float ms) override;
 
-    void predraw() override;
+    RadiusLightMesh* prepare_light() override;
 
     void draw(const mat3& projection) override;
 
@@ -1,28 +1,40 @@
   // Header
 #include "laserlight_mesh.hpp"
 #include "CollisionManager.hpp"
+#include "SegmentBatch.hpp"
+#include "GeometryStream.hpp"
 
 // stlib
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <iostream>
-#include <set>
 
 // external
 #include "world.hpp"
 
 #define PI 3.14159265
 
+namespace
+{
+	// A line the rays of the laser may cross, in our rotated coord system, with the x range it covers
+	struct SweptLine
+	{
+		ParametricLine line;
+		float minX;
+		float maxX;
+		int entityIndex;	// Snapshot item of the entity it bounds, -1 for light blocking lines
+	};
+}
+
 bool LaserLightMesh::init()
 {
 	m_laserLength = 1000.f;
 	m_laserWidth = 15.f;
+	lightAngle = 0.f;
+	actualLength = 0.f;
 
-	// Vertex Buffer creation
-	glGenBuffers(1, &mesh.vbo);
-	// Index Buffer creation
-	glGenBuffers(1, &mesh.ibo);
+	// Vertices and indices are streamed through GeometryStream every frame
 	// Vertex Array (Container for Vertex + Index buffer)
 	glGenVertexArrays(1, &mesh.vao);
 	if (gl_has_errors())
@@ -38,8 +50,6 @@ bool LaserLightMesh::init()
 // Releases all graphics resources
 void LaserLightMesh::destroy()
 {
-	glDeleteBuffers(1, &mesh.vbo);
-	glDeleteBuffers(1, &mesh.ibo);
 	glDeleteVertexArrays(1, &mesh.vao);
 
 	effect.release();
@@ -55,8 +65,7 @@ void LaserLightMesh::draw(const mat3& projection)
 	// transform_rotate()
 	// transform_scale()
 
-	transform_translate(m_parent.m_position);
-	lightAngle = std::atan2(m_parent.m_mousePosition.y, m_parent.m_mousePosition.x) - PI / 2;
+	transform_translate(m_polygonPosition);
 	transform_rotate(lightAngle);
 	transform_end();
 
@@ -75,16 +84,16 @@ void LaserLightMesh::draw(const mat3& projection)
 
 	// Setting vertices and indices
 	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexAllocation.buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexAllocation.buffer);
 
 	// Input data location as in the vertex buffer
 	GLint in_position_loc = glGetAttribLocation(effect.program, "in_position");
 	GLint in_color_loc = glGetAttribLocation(effect.program, "in_color");
 	glEnableVertexAttribArray(in_position_loc);
 	glEnableVertexAttribArray(in_color_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(vec3));
+	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)m_vertexAllocation.offset);
+	glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(m_vertexAllocation.offset + sizeof(vec3)));
 	
 	// Setting uniform values to the currently bound program
 	glUniformMatrix3fv(transform_uloc, 1, GL_FALSE, (float*)&transform);
@@ -94,25 +103,47 @@ void LaserLightMesh::draw(const mat3& projection)
 	glUniformMatrix3fv(projection_uloc, 1, GL_FALSE, (float*)&projection);
 	glUniform1f(light_width, m_laserWidth);
 
-	// Recreate polygonial mesh based on objects that block light around us
-	int toRender = UpdateVertices();
-
 	// Drawing!
-	glDrawElements(GL_TRIANGLES, toRender, GL_UNSIGNED_SHORT, nullptr);
+	glDrawElements(GL_TRIANGLES, indicesToDraw, GL_UNSIGNED_INT, (void*)m_indexAllocation.offset);
+
+	// Stream space only lasts a frame, a polygon that is not uploaded again is not drawn again
+	indicesToDraw = 0;
+}
+
+void LaserLightMesh::LightUpEntities()
+{
+	for (Entity* entity : m_litEntities)
+	{
+		entity->set_lit(true);
+	}
+}
+
+void LaserLightMesh::UploadPolygon()
+{
+	GeometryStream& stream = GeometryStream::GetInstance();
+	m_vertexAllocation = stream.Write(m_vertices.data(), sizeof(Vertex) * m_vertices.size());
+	m_indexAllocation = stream.Write(m_indices.data(), sizeof(uint32_t) * m_indices.size());
+
+	indicesToDraw = m_indices.size();
 }
 
-int LaserLightMesh::UpdateVertices()
+void LaserLightMesh::ComputePolygon()
 {
 	// Find angle where we're going to face
+	m_polygonPosition = m_parent.m_position;
+	lightAngle = std::atan2(m_parent.m_mousePosition.y, m_parent.m_mousePosition.x) - PI / 2;
 	float cosA = std::cos(lightAngle);
 	float sinA = std::sin(lightAngle);
 
 	// Update our collision equations based on where we are in the world
 	const CollisionManager& colManager = CollisionManager::GetInstance();
 
-	// Get all relevant entities in radius
-	std::vector<Entity*> entities = colManager.GetEntitiesInRange(m_parent.m_position.x, m_parent.m_position.y, m_laserLength);
-	
+	// Everything in range, as of this frame's snapshot: entities, and wall outlines that belong to none
+	const LightSnapshot& snapshot = colManager.GetLightSnapshot();
+	std::vector<int>& items = m_snapshotItems;
+	items.clear();
+	snapshot.QueryInRadius(m_parent.m_position, m_laserLength, AabbStore::ACTIVE, 0, items);
+
 	std::vector<vec2> relevantPoints;
 
 	// Add our left and right boundaries
@@ -122,19 +153,24 @@ int LaserLightMesh::UpdateVertices()
 	// Transform entity corners into our rotation in which lightAngle is 'up' (90 deg)
 	// We work in this rotation, in which the light starts at (0,0) and goes up to (0,lightLength)
 	// The bottom two coordinates of the light is (-lightWidth, 0), (lightWidth, 0)
-	for (Entity* entity : entities)
+	for (int item : items)
 	{
-		vec2 posToEntity = { entity->get_position().x - m_parent.m_position.x, entity->get_position().y - m_parent.m_position.y };
+		if (snapshot.GetItem(item).entity == nullptr)
+		{
+			continue;
+		}
+
+		vec2 posToEntity = { snapshot.GetPosition(item).x - m_parent.m_position.x, snapshot.GetPosition(item).y - m_parent.m_position.y };
 
-		const float xRadius = entity->get_bounding_box().x / 2;
-		const float yRadius = entity->get_bounding_box().y / 2;
+		const float xRadius = snapshot.GetHalfBound(item).x;
+		const float yRadius = snapshot.GetHalfBound(item).y;
 
 		vec2 topRight = { posToEntity.x + xRadius, posToEntity.y - yRadius };
 		vec2 topLeft = { posToEntity.x - xRadius, posToEntity.y - yRadius };
 		vec2 bottomRight = { posToEntity.x + xRadius, posToEntity.y + yRadius };
 		vec2 bottomLeft = { posToEntity.x - xRadius, posToEntity.y + yRadius };
 
-		std::vector<vec2> entityPoints = { topRight, topLeft, bottomLeft, bottomRight };
+		vec2 entityPoints[] = { topRight, topLeft, bottomLeft, bottomRight };
 
 		for (vec2& point : entityPoints)
 		{
@@ -160,74 +196,130 @@ int LaserLightMesh::UpdateVertices()
 		return point1.x < point2.x;
 	});
 
-	// Bound lines is a list of entities and their boundary lines
-	// We also rotate these lines to our world coord rotation
-	std::vector<EntityLines> entityLines;
-	for (Entity* entity : entities)
+	// Rays of the strip only span its x range, from y = 0 to the laser's end. Lines out of that box can never be hit.
+	// Lines are also padded a little along x, the exact ray test below has the final say
+	const float margin = 0.01f;
+	const float stripMinX = relevantPoints.front().x - margin;
+	const float stripMaxX = relevantPoints.back().x + margin;
+	auto addIfInStrip = [&](const ParametricLine& line, int entityIndex, std::vector<SweptLine>& outLines)
+	{
+		SweptLine sweptLine;
+		sweptLine.line = line;
+		sweptLine.minX = std::min(line.x_0, line.x_0 + line.x_t) - margin;
+		sweptLine.maxX = std::max(line.x_0, line.x_0 + line.x_t) + margin;
+		sweptLine.entityIndex = entityIndex;
+
+		const float minY = std::min(line.y_0, line.y_0 + line.y_t);
+		const float maxY = std::max(line.y_0, line.y_0 + line.y_t);
+		if (sweptLine.maxX >= stripMinX && sweptLine.minX <= stripMaxX && maxY >= -margin && minY <= m_laserLength + margin)
+		{
+			outLines.push_back(sweptLine);
+		}
+	};
+
+	// Boundary lines of entities (to find what we light up) and light blocking lines, rotated to our coord system
+	std::vector<SweptLine> boundaryLines;
+	std::vector<SweptLine> sweptOccluders;
+	for (int item : items)
+	{
+		const LightSnapshot::Item& snapshotItem = snapshot.GetItem(item);
+		for (int line = snapshotItem.firstBoundary; line < snapshotItem.firstBoundary + snapshotItem.boundaryCount; line++)
+		{
+			addIfInStrip(ConvertLineToAngle(snapshot.GetBoundaryLines()[line], cosA, sinA), item, boundaryLines);
+		}
+		for (int line = snapshotItem.firstOccluder; line < snapshotItem.firstOccluder + snapshotItem.occluderCount; line++)
+		{
+			addIfInStrip(ConvertLineToAngle(snapshot.GetOccluder(line), cosA, sinA), -1, sweptOccluders);
+		}
+	}
+
+	// Rays are swept by increasing x, lines join the sweep once it reaches their start.
+	// Light blocking lines are packed in that order, so that their index in the batch is their index in sweptOccluders
+	auto byMinX = [](const SweptLine& line1, const SweptLine& line2) { return line1.minX < line2.minX; };
+	std::sort(boundaryLines.begin(), boundaryLines.end(), byMinX);
+	std::sort(sweptOccluders.begin(), sweptOccluders.end(), byMinX);
+
+	SegmentBatch occluderLines;
+	for (const SweptLine& sweptLine : sweptOccluders)
+	{
+		occluderLines.Add(sweptLine.line);
+	}
+	SegmentBatch boundaryBatch;
+	for (const SweptLine& sweptLine : boundaryLines)
 	{
-		EntityLines entityLine;
-		entityLine.entity = entity;
-		entityLine.boundaryLines = ConvertLinesToAngle(entity->calculate_boundary_equations(), cosA, sinA);
-		
-		ParametricLines staticLines = ConvertLinesToAngle(entity->calculate_static_equations(), cosA, sinA);
-		ParametricLines dynamicLines = ConvertLinesToAngle(entity->calculate_dynamic_equations(), cosA, sinA);
-
-		entityLine.lightCollisionLines = staticLines;
-		entityLine.lightCollisionLines.insert(entityLine.lightCollisionLines.end(), dynamicLines.begin(), dynamicLines.end());
- 
-		entityLines.push_back(entityLine);
+		boundaryBatch.Add(sweptLine.line);
 	}
 
+	// Lines under the current ray, added as the sweep reaches them and dropped once it has passed them
+	std::vector<int> activeBoundaries;
+	std::vector<int> activeOccluders;
+	std::vector<int> hitBoundaries;
+	size_t nextBoundary = 0;
+	size_t nextOccluder = 0;
+	auto sweepTo = [](float x, const std::vector<SweptLine>& lines, size_t& next, std::vector<int>& active)
+	{
+		while (next < lines.size() && lines[next].minX <= x)
+		{
+			active.push_back(next++);
+		}
+		for (size_t i = 0; i < active.size();)
+		{
+			if (lines[active[i]].maxX < x)
+			{
+				active[i] = active.back();
+				active.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+	};
+
 	// Check collisions, these will be the vertices of our polygon
 	actualLength = 0.f;
 	std::vector<vec2> polyVertices;
+	std::vector<Entity*>& litEntities = m_litEntities;
+	litEntities.clear();
 	for (const vec2& corner : relevantPoints)
 	{
+		sweepTo(corner.x, boundaryLines, nextBoundary, activeBoundaries);
+		sweepTo(corner.x, sweptOccluders, nextOccluder, activeOccluders);
+
 		ParametricLine rayTrace;
 		rayTrace.x_0 = corner.x;
 		rayTrace.x_t = 0.f;
 		rayTrace.y_0 = 0.f;
 		rayTrace.y_t = m_laserLength;
 
-		vec2 hitPosition = { corner.x, m_laserLength };
-
-		// Keep track of all entities hit
-		for (EntityLines& entityLine : entityLines)
+		// Stop at the nearest light blocking line
+		float hitTime;
+		if (occluderLines.Raycast(rayTrace, 1.f, activeOccluders.data(), (int)activeOccluders.size(), hitTime) != -1)
 		{
-			for (ParametricLine lightLine : entityLine.lightCollisionLines)
-			{
-				vec2 collisionLocation;
-				if (colManager.LinesCollide(rayTrace, lightLine, collisionLocation))
-				{
-					if (collisionLocation.Magnitude() < hitPosition.Magnitude())
-					{
-						hitPosition = collisionLocation;
-					}
-				}
-			}
+			rayTrace.y_t *= hitTime;
 		}
 
-		rayTrace.y_t = hitPosition.y;
+		const vec2 hitPosition = { corner.x, rayTrace.y_t };
 
-		for (EntityLines& entityLine : entityLines)
+		hitBoundaries.clear();
+		boundaryBatch.RaycastAll(rayTrace, 1.f, activeBoundaries.data(), (int)activeBoundaries.size(), hitBoundaries);
+		for (int boundary : hitBoundaries)
 		{
-			for (ParametricLine boundLine : entityLine.boundaryLines)
-			{
-				vec2 collisionLocation;
-				if (colManager.LinesCollide(rayTrace, boundLine, collisionLocation))
-				{
-						entityLine.entity->set_lit(true);
-				}
-			}
+			litEntities.push_back(snapshot.GetItem(boundaryLines[boundary].entityIndex).entity);
 		}
 
         actualLength = std::max(actualLength, hitPosition.y);
 		polyVertices.push_back(hitPosition);
 	}
 
-	// Create vertices, we are still working in our lightAngle rotation coord system
-	std::vector<uint16_t> indices;
-	std::vector<Vertex> vertices;
+	std::sort(litEntities.begin(), litEntities.end());
+	litEntities.erase(std::unique(litEntities.begin(), litEntities.end()), litEntities.end());
+
+	// Create vertices, we are still working in our lightAngle rotation coord system. UploadPolygon sends them to openGL
+	std::vector<uint32_t>& indices = m_indices;
+	std::vector<Vertex>& vertices = m_vertices;
+	indices.clear();
+	vertices.clear();
 	Vertex vertex;
 	vertex.color = { 1.f, 1.f, 1.f };
 	
@@ -256,40 +348,24 @@ int LaserLightMesh::UpdateVertices()
 		indices.push_back(count - 1);
 		indices.push_back(count + 1);
 	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
-
-	return indices.size();
 }
 
-ParametricLines LaserLightMesh::ConvertLinesToAngle(ParametricLines lines, float cosA, float sinA)
+ParametricLine LaserLightMesh::ConvertLineToAngle(ParametricLine line, float cosA, float sinA) const
 {
-	ParametricLines outLines;
-	for (ParametricLine line : lines)
-	{
-		line.x_0 = line.x_0 - m_parent.m_position.x;
-		line.y_0 = line.y_0 - m_parent.m_position.y;
+	vec2 startingPoint = { line.x_0 - m_parent.m_position.x, line.y_0 - m_parent.m_position.y };
+	float newStartX = startingPoint.x * cosA + startingPoint.y * sinA;
+	float newStartY = startingPoint.x * -sinA + startingPoint.y * cosA;
 
-		vec2 startingPoint = { line.x_0, line.y_0 };
-		float newStartX = startingPoint.x * cosA + startingPoint.y * sinA;
-		float newStartY = startingPoint.x * -sinA + startingPoint.y * cosA;
+	vec2 endPoint = { line.x_t, line.y_t };
+	float newEndX = endPoint.x * cosA + endPoint.y * sinA;
+	float newEndY = endPoint.x * -sinA + endPoint.y * cosA;
 
-		vec2 endPoint = { line.x_t, line.y_t };
-		float newEndX = endPoint.x * cosA + endPoint.y * sinA;
-		float newEndY = endPoint.x * -sinA + endPoint.y * cosA;
-
-		line.x_0 = newStartX;
-		line.y_0 = newStartY;
-		line.x_t = newEndX;
-		line.y_t = newEndY;
-
-		outLines.push_back(line);
-	}
+	line.x_0 = newStartX;
+	line.y_0 = newStartY;
+	line.x_t = newEndX;
+	line.y_t = newEndY;
 
-	return outLines;
+	return line;
 }
 
 vec2 LaserLightMesh::get_position() const
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "common.hpp"
+#include "GeometryStream.hpp"
 
 class World;
+class Entity;
 
 class LaserLightMesh : public Renderable
 {
@@ -31,6 +33,15 @@ public:
 		m_enablePolygon = !m_enablePolygon;
 	};
 
+	// Rebuilds the polygon on the CPU and finds what it reaches. Touches no GL, it is part of the update
+	void ComputePolygon();
+
+	// Lights up the entities the polygon built by ComputePolygon reaches
+	void LightUpEntities();
+
+	// Writes the polygon built by ComputePolygon to this frame's GeometryStream, for draw. Has to be called on the GL thread
+	void UploadPolygon();
+
     // how long the laser actually is
     float actualLength;
 
@@ -38,10 +49,8 @@ public:
     float lightAngle;
 
 private:
-	// Recreate polygonial mesh based on objects that block light around us. Happens per frame.
-	int UpdateVertices();
-
-	ParametricLines ConvertLinesToAngle(ParametricLines lines, float cosA, float sinA);
+	// Moves a world space line into our coord system, relative to the light and rotated so that it points up
+	ParametricLine ConvertLineToAngle(ParametricLine line, float cosA, float sinA) const;
 
 	// Data from the parent object (only player for now, but maybe lanterns too in future)
 	ParentData m_parent;
@@ -52,4 +61,19 @@ private:
 	float m_laserWidth;
 
 	bool m_enablePolygon = false;
+
+	// Snapshot items in range, kept so that their storage is reused
+	std::vector<int> m_snapshotItems;
+
+	// Built by ComputePolygon, from where the light was then. draw uses it until the next one
+	vec2 m_polygonPosition = { 0.f, 0.f };
+	std::vector<Vertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<Entity*> m_litEntities;
+
+	int indicesToDraw = 0;
+
+	// Where UploadPolygon wrote them this frame
+	GeometryStream::Allocation m_vertexAllocation;
+	GeometryStream::Allocation m_indexAllocation;
 };
@@ -1,12 +1,9 @@
 #include "entity.hpp"
 #include "movable_wall.hpp"
 #include "CollisionManager.hpp"
-#include "player.hpp"
 
 #include <iostream>
 
-#define BLOCK_SIZE 64
-
 bool MovableWall::init(float xPos, float yPos)
 {
 	initial_position = { xPos, yPos };
@@ -185,25 +182,10 @@ void MovableWall::update(float ms) {
 				vec2 curvePath = previousLocation * oneMinusTimeFrac * oneMinusTimeFrac + currentCurvePoint * 2 * oneMinusTimeFrac * timeFrac + currentTargetLocation * timeFrac * timeFrac;
 				newPos = curvePath;
 			}
-
-			velocity.x = newPos.x - pos.x;
-			velocity.y = newPos.y - pos.y;
-		}
-
-		vec2 movement = newPos - pos;
-		CollisionManager::CollisionResult collisionResult;
-		bool collidesWithPlayer = CollisionManager::GetInstance().CollidesWithPlayer(pos, get_bounding_box(), movement, collisionResult);
-
-		if (collidesWithPlayer)
-		{
-			CollisionManager::GetInstance().MovePlayer({ collisionResult.resultXPos, collisionResult.resultYPos });
 		}
 
-		set_position(newPos);
-	}
-	else {
-		velocity.x = 0;
-		velocity.y = 0;
+		// Pushing and carrying the player is resolved once every platform has moved
+		CollisionManager::GetInstance().MoveKinematicBody(this, newPos);
 	}
 }
 
@@ -216,8 +198,3 @@ ParametricLines MovableWall::calculate_dynamic_equations() const
 {
 	return Entity::calculate_static_equations();
 }
-
-vec2 MovableWall::get_velocity()
-{
-	return velocity;
-}
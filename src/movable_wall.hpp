@@ -17,6 +17,7 @@ public:
 	void deactivate() override;
 
 	bool is_light_dynamic() const override { return true; }
+	bool is_static_tile() const override { return false; }
 	virtual bool activated_by_light() const override { return false; }
 
 
@@ -25,8 +26,6 @@ public:
 	ParametricLines calculate_static_equations() const override;
 	ParametricLines calculate_dynamic_equations() const override;
 
-	vec2 get_velocity();
-
 private:
 	void AdvanceToNextPoint();
 
@@ -53,6 +52,4 @@ private:
 	bool isReversed;
 
 	float currentTime;
-
-	vec2 velocity;
 };
@@ -117,22 +117,13 @@ void Player::update(float ms)
 
 void Player::draw(const mat3& projection)
 {
+	// Light polygons were computed by World::update, from where the player was then
 	if (isLaserMode)
 	{
-		LaserLightMesh::ParentData lightData;
-		lightData.m_position = m_position;
-		lightData.m_mousePosition = mousePosition;
-
-		laserLightMesh.SetParentData(lightData);
 		laserLightMesh.draw(projection);
 	}
 	else
 	{
-		RadiusLightMesh::ParentData radiusLightData;
-		radiusLightData.m_position = m_position;
-
-		radiusLightMesh.SetParentData(radiusLightData);
-		radiusLightMesh.predraw();
 		radiusLightMesh.draw(projection);
 	}
 
@@ -184,6 +175,31 @@ bool Player::getLightMode() {
 	return isLaserMode;
 }
 
+RadiusLightMesh* Player::prepare_light() {
+	if (isLaserMode)
+	{
+		return nullptr;
+	}
+
+	RadiusLightMesh::ParentData radiusLightData;
+	radiusLightData.m_position = m_position;
+	radiusLightMesh.SetParentData(radiusLightData);
+	return &radiusLightMesh;
+}
+
+LaserLightMesh* Player::prepare_laser() {
+	if (!isLaserMode)
+	{
+		return nullptr;
+	}
+
+	LaserLightMesh::ParentData lightData;
+	lightData.m_position = m_position;
+	lightData.m_mousePosition = mousePosition;
+	laserLightMesh.SetParentData(lightData);
+	return &laserLightMesh;
+}
+
 const RadiusLightMesh* Player::getPlayerRadiusLight() {
     if (isLaserMode)
     {
@@ -27,6 +27,12 @@ public:
 	vec2 get_position()const;
 
 	const RadiusLightMesh* getPlayerRadiusLight();
+
+	// Radius light to compute this frame, none while the laser is out
+	RadiusLightMesh* prepare_light();
+
+	// Laser to compute this frame, none while the radius light is on
+	LaserLightMesh* prepare_laser();
 	const LaserLightMesh* getPlayerLaserLight();
 
 	// Moves the player's position by the specified offset
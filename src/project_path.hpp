@@ -0,0 +1,5 @@
+#pragma once
+
+// Please don't change the content of this header
+
+#define PROJECT_SOURCE_DIR "/root/repo/"
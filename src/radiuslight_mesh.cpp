@@ -1,10 +1,12 @@
   // Header
 #include "radiuslight_mesh.hpp"
 #include "CollisionManager.hpp"
+#include "SegmentBatch.hpp"
+#include "GeometryStream.hpp"
+#include "SpriteBatch.hpp"
 
 // stlib
 #include <vector>
-#include <array>
 #include <string>
 #include <algorithm>
 #include <iostream>
@@ -14,7 +16,11 @@
 #include "world.hpp"
 
 #define PI 3.14159265
-#define SECTORSIZE 25
+
+// Two extra rays are cast slightly to each side of every corner, this many radians away. Rotating by it only needs these
+const float SIDE_RAY_RADIAN = 0.0001f;
+const float SIDE_RAY_COS = std::cos(SIDE_RAY_RADIAN);
+const float SIDE_RAY_SIN = std::sin(SIDE_RAY_RADIAN);
 
 // For performance testing
 // using Clock = std::chrono::high_resolution_clock;
@@ -24,15 +30,28 @@
 //						 std::cout << Name << " time: " << time_Name << std::endl
 
 
+RadiusLightMesh::PolygonAlgorithm RadiusLightMesh::polygonAlgorithm = RadiusLightMesh::PolygonAlgorithm::RayCast;
+
+void RadiusLightMesh::TogglePolygonAlgorithm()
+{
+	if (polygonAlgorithm == PolygonAlgorithm::RayCast)
+	{
+		polygonAlgorithm = PolygonAlgorithm::AngularSweep;
+		std::cout << "Light polygons: angular sweep" << std::endl;
+	}
+	else
+	{
+		polygonAlgorithm = PolygonAlgorithm::RayCast;
+		std::cout << "Light polygons: ray cast" << std::endl;
+	}
+}
 
 bool RadiusLightMesh::init()
 {
 	m_lightRadius = 300.f;
+	m_hasPolygon = false;
 
-	// Vertex Buffer creation
-	glGenBuffers(1, &mesh.vbo);
-	// Index Buffer creation
-	glGenBuffers(1, &mesh.ibo);
+	// Vertices and indices are streamed through GeometryStream every frame
 	// Vertex Array (Container for Vertex + Index buffer)
 	glGenVertexArrays(1, &mesh.vao);
 	if (gl_has_errors())
@@ -48,8 +67,6 @@ bool RadiusLightMesh::init()
 // Releases all graphics resources
 void RadiusLightMesh::destroy()
 {
-	glDeleteBuffers(1, &mesh.vbo);
-	glDeleteBuffers(1, &mesh.ibo);
 	glDeleteVertexArrays(1, &mesh.vao);
 
 	effect.release();
@@ -57,6 +74,9 @@ void RadiusLightMesh::destroy()
 
 void RadiusLightMesh::draw(const mat3& projection)
 {
+	// Drawn over the sprites queued before us
+	SpriteBatch::GetInstance().Flush();
+
 	transform_begin();
 
 	// see Transformations and Rendering in the specification pdf
@@ -85,16 +105,16 @@ void RadiusLightMesh::draw(const mat3& projection)
 
 	// Setting vertices and indices
 	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexAllocation.buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexAllocation.buffer);
 
 	// Input data location as in the vertex buffer
 	GLint in_position_loc = glGetAttribLocation(effect.program, "in_position");
 	GLint in_color_loc = glGetAttribLocation(effect.program, "in_color");
 	glEnableVertexAttribArray(in_position_loc);
 	glEnableVertexAttribArray(in_color_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(vec3));
+	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)m_vertexAllocation.offset);
+	glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(m_vertexAllocation.offset + sizeof(vec3)));
 	
 	// Setting uniform values to the currently bound program
 	glUniformMatrix3fv(transform_uloc, 1, GL_FALSE, (float*)&transform);
@@ -106,16 +126,31 @@ void RadiusLightMesh::draw(const mat3& projection)
 	glUniform1i(show_polygon, (int) m_enablePolygon);
 
 	// Drawing!
-	glDrawElements(GL_TRIANGLES, indicesToDraw, GL_UNSIGNED_SHORT, nullptr);
+	glDrawElements(GL_TRIANGLES, indicesToDraw, GL_UNSIGNED_INT, (void*)m_indexAllocation.offset);
+
+	// Stream space only lasts a frame, a polygon that is not uploaded again is not drawn again
+	indicesToDraw = 0;
+}
+
+void RadiusLightMesh::LightUpEntities()
+{
+	for (Entity* entity : m_litEntities)
+	{
+		entity->set_lit(true);
+	}
 }
 
-void RadiusLightMesh::predraw()
+void RadiusLightMesh::UploadPolygon()
 {
-	// Recreate polygonial mesh based on objects that block light around us
-	UpdateVertices();
+	// Stream space only lasts a frame, so a reused polygon is written again too
+	GeometryStream& stream = GeometryStream::GetInstance();
+	m_vertexAllocation = stream.Write(m_vertices.data(), sizeof(Vertex) * m_vertices.size());
+	m_indexAllocation = stream.Write(m_indices.data(), sizeof(uint32_t) * m_indices.size());
+
+	indicesToDraw = m_indices.size();
 }
 
-void RadiusLightMesh::UpdateVertices()
+void RadiusLightMesh::ComputePolygon()
 {
 //	startTiming("Polygon");
 
@@ -123,8 +158,32 @@ void RadiusLightMesh::UpdateVertices()
 	// CollisionManager is friend
 	const CollisionManager& colManager = CollisionManager::GetInstance();
 
-	// Get all relevant entities in radius
-	std::vector<Entity*> entities = colManager.GetEntitiesInRange(m_parent.m_position.x, m_parent.m_position.y, m_lightRadius);
+	// Nothing around us changed since the last polygon (e.g. a lantern in a still room), keep it and only light up what it lit
+	const uint64_t inputStamp = colManager.GetLightInputStamp(m_parent.m_position.x, m_parent.m_position.y, m_lightRadius);
+	if (m_hasPolygon && inputStamp == m_polygonInputStamp && polygonAlgorithm == m_polygonAlgorithm &&
+		m_parent.m_position.x == m_polygonPosition.x && m_parent.m_position.y == m_polygonPosition.y && m_lightRadius == m_polygonRadius)
+	{
+		return;
+	}
+
+	m_litEntities.clear();
+
+	// Everything in radius, as of this frame's snapshot: entities, and wall outlines that belong to none
+	const LightSnapshot& snapshot = colManager.GetLightSnapshot();
+	std::vector<int>& items = m_snapshotItems;
+	items.clear();
+	snapshot.QueryInRadius(m_parent.m_position, m_lightRadius, AabbStore::ACTIVE, 0, items);
+
+	// entities[i] is the snapshot item of an entity
+	std::vector<int>& entities = m_entityItems;
+	entities.clear();
+	for (int item : items)
+	{
+		if (snapshot.GetItem(item).entity != nullptr)
+		{
+			entities.push_back(item);
+		}
+	}
 
 	// Ordered points is not ordered yet, but we will sort it at the end, hence they are called orderedPoints
 	std::vector<vec2> orderedPoints;
@@ -141,30 +200,28 @@ void RadiusLightMesh::UpdateVertices()
 	orderedPoints.push_back(bottomLeft);
 
 	// Process each entity's corners to orderedPoints
-	for (Entity* entity : entities)
+	for (int entity : entities)
 	{
-		vec2 posToEntity = { entity->get_position().x - m_parent.m_position.x, entity->get_position().y - m_parent.m_position.y };
+		vec2 posToEntity = { snapshot.GetPosition(entity).x - m_parent.m_position.x, snapshot.GetPosition(entity).y - m_parent.m_position.y };
 
-		const float xRadius = entity->get_bounding_box().x / 2;
-		const float yRadius = entity->get_bounding_box().y / 2;
+		const float xRadius = snapshot.GetHalfBound(entity).x;
+		const float yRadius = snapshot.GetHalfBound(entity).y;
 
 		vec2 topRight = { posToEntity.x + xRadius, posToEntity.y - yRadius };
 		vec2 topLeft = { posToEntity.x - xRadius, posToEntity.y - yRadius };
 		vec2 bottomRight = { posToEntity.x + xRadius, posToEntity.y + yRadius };
 		vec2 bottomLeft = { posToEntity.x - xRadius, posToEntity.y + yRadius };
 
-		std::vector<vec2> entityPoints = { topRight, topLeft, bottomLeft, bottomRight };
+		const vec2 entityPoints[] = { topRight, topLeft, bottomLeft, bottomRight };
 
 		// For each vertex, add two more lines slightly to the left and right
 		// https://ncase.me/sight-and-light/
 		for (const vec2& corner : entityPoints)
 		{
-			const float smallRadian = 0.0001f;
-			const float angle = std::atan2(corner.y, corner.x);
-			const float clockwise = angle - smallRadian;
-			const float antiClockwise = angle + smallRadian;
-			const vec2 clockwisePoint = { (float) cos(clockwise), (float) sin(clockwise) };
-			const vec2 antiClockwisePoint = { (float) cos(antiClockwise), (float) sin(antiClockwise) };
+			const float distance = corner.Magnitude();
+			const vec2 direction = distance > 0.f ? vec2{ corner.x / distance, corner.y / distance } : vec2{ 1.f, 0.f };
+			const vec2 clockwisePoint = { direction.x * SIDE_RAY_COS + direction.y * SIDE_RAY_SIN, direction.y * SIDE_RAY_COS - direction.x * SIDE_RAY_SIN };
+			const vec2 antiClockwisePoint = { direction.x * SIDE_RAY_COS - direction.y * SIDE_RAY_SIN, direction.y * SIDE_RAY_COS + direction.x * SIDE_RAY_SIN };
 
 			orderedPoints.push_back(clockwisePoint * m_lightRadius * 2);
 			orderedPoints.push_back(corner);
@@ -172,116 +229,154 @@ void RadiusLightMesh::UpdateVertices()
 		}
 	}
 
-	// Sort points by smallest angle to largest angle to the positive x-axis
-	std::sort(orderedPoints.begin(), orderedPoints.end(), [](const vec2& point1, const vec2& point2)
+	// Sort points by smallest angle to largest angle to the positive x-axis (y points down, and an angle of 0 goes last).
+	// Each point's angle is only needed for ordering, so it is computed once as a pseudo angle
+	std::vector<std::pair<float, vec2>> pointsByAngle;
+	pointsByAngle.reserve(orderedPoints.size());
+	for (const vec2& point : orderedPoints)
 	{
-		float angle1 = std::atan2(-point1.y, point1.x);
-		angle1 = angle1 > 0 ? angle1 : 2 * PI + angle1;
-		float angle2 = std::atan2(-point2.y, point2.x);
-		angle2 = angle2 > 0 ? angle2 : 2 * PI + angle2;
-
-		return angle1 < angle2;
+		const float angle = pseudo_angle({ point.x, -point.y });
+		pointsByAngle.push_back({ angle > 0.f ? angle : 4.f, point });
+	}
+	std::sort(pointsByAngle.begin(), pointsByAngle.end(), [](const std::pair<float, vec2>& point1, const std::pair<float, vec2>& point2)
+	{
+		return point1.first < point2.first;
 	});
-
-	// Bound lines is a list of entities and their boundary lines
-	std::array<std::vector<EntityLines>, SECTORSIZE> entityLinesByAngles;
-	for (Entity* entity : entities)
+	for (size_t i = 0; i < pointsByAngle.size(); i++)
 	{
-		EntityLines entityLine;
-		entityLine.entity = entity;
+		orderedPoints[i] = pointsByAngle[i].second;
+	}
 
-		std::set<int> indexesToAdd;
+	// Light blocking lines and the boundary lines of entities (to find what we light up) are gathered once.
+	// For ray casting they are then filed by index under the sectors they cross, so that a ray is only tested against
+	// its own sector. The angular sweep takes every light blocking line at once
+	const bool useSweep = polygonAlgorithm == PolygonAlgorithm::AngularSweep;
+	ParametricLines& occluderLines = m_occluderLines;
+	occluderLines.clear();
+
+	// Boundary lines of entities[i] are boundaryLines[boundaryStarts[i]] to boundaryLines[boundaryStarts[i + 1]]
+	ParametricLines& boundaryLines = m_boundaryLines;
+	std::vector<int>& boundaryStarts = m_boundaryStarts;
+	boundaryLines.clear();
+	boundaryStarts.clear();
+	m_boundaryBatch.Clear();
+
+	for (int entity : entities)
+	{
+		const LightSnapshot::Item& entityItem = snapshot.GetItem(entity);
+		boundaryStarts.push_back(boundaryLines.size());
 
-		for (ParametricLine boundLine : entity->calculate_boundary_equations())
+		for (int line = entityItem.firstBoundary; line < entityItem.firstBoundary + entityItem.boundaryCount; line++)
 		{
+			ParametricLine boundLine = snapshot.GetBoundaryLines()[line];
 			boundLine.x_0 = boundLine.x_0 - m_parent.m_position.x;
 			boundLine.y_0 = boundLine.y_0 - m_parent.m_position.y;
-
-			DetermineLineSectors(boundLine, indexesToAdd);
-
-			entityLine.boundaryLines.push_back(boundLine);
+			boundaryLines.push_back(boundLine);
+			m_boundaryBatch.Add(boundLine);
 		}
+	}
+	boundaryStarts.push_back(boundaryLines.size());
 
-		for (ParametricLine staticLine : entity->calculate_static_equations())
+	// Light blocking lines of entities and of wall outlines alike
+	for (int item : items)
+	{
+		const LightSnapshot::Item& occluderItem = snapshot.GetItem(item);
+		for (int line = occluderItem.firstOccluder; line < occluderItem.firstOccluder + occluderItem.occluderCount; line++)
 		{
-			staticLine.x_0 = staticLine.x_0 - m_parent.m_position.x;
-			staticLine.y_0 = staticLine.y_0 - m_parent.m_position.y;
-
-			DetermineLineSectors(staticLine, indexesToAdd);
-
-			entityLine.lightCollisionLines.push_back(staticLine);
+			ParametricLine occluderLine = snapshot.GetOccluder(line);
+			occluderLine.x_0 = occluderLine.x_0 - m_parent.m_position.x;
+			occluderLine.y_0 = occluderLine.y_0 - m_parent.m_position.y;
+			occluderLines.push_back(occluderLine);
 		}
+	}
 
-		for (ParametricLine dynamicLine : entity->calculate_dynamic_equations())
+	// The sweep finds where every ray stops in one go
+	std::vector<vec2> sweepHits;
+	if (useSweep)
+	{
+		m_visibilitySweep.Compute(occluderLines, orderedPoints, sweepHits);
+	}
+	else
+	{
+		m_occluderBatch.Clear();
+		m_occluderBins.Reset(occluderLines.size());
+		for (int i = 0; i < (int)occluderLines.size(); i++)
 		{
-			dynamicLine.x_0 = dynamicLine.x_0 - m_parent.m_position.x;
-			dynamicLine.y_0 = dynamicLine.y_0 - m_parent.m_position.y;
-
-			DetermineLineSectors(dynamicLine, indexesToAdd);
-
-			entityLine.lightCollisionLines.push_back(dynamicLine);
+			AngularBins::SectorSet sectors;
+			m_occluderBins.MarkSectors(occluderLines[i], sectors);
+			m_occluderBins.Add(i, sectors);
+			m_occluderBatch.Add(occluderLines[i]);
 		}
+		m_occluderBins.Build();
+	}
 
-		for (int index : indexesToAdd)
+	m_entityBins.Reset(boundaryLines.size());
+	for (int i = 0; i < (int)entities.size(); i++)
+	{
+		AngularBins::SectorSet sectors;
+		for (int line = boundaryStarts[i]; line < boundaryStarts[i + 1]; line++)
 		{
-			entityLinesByAngles[index].push_back(entityLine);
+			m_entityBins.MarkSectors(boundaryLines[line], sectors);
 		}
+		m_entityBins.Add(i, sectors);
 	}
+	m_entityBins.Build();
 
 	// For each point, rayTrace from origin to it. The result will be one vertex for our polygon
 	std::vector<vec2> polyVertices;
-	for (const vec2& corner : orderedPoints)
+	for (size_t pointIndex = 0; pointIndex < orderedPoints.size(); pointIndex++)
 	{
+		const vec2& corner = orderedPoints[pointIndex];
+
 		ParametricLine rayTrace;
 		rayTrace.x_0 = 0.f;
 		rayTrace.x_t = corner.x;
 		rayTrace.y_0 = 0.f;
 		rayTrace.y_t = corner.y;
 
-		float raytraceAngle = std::atan2(-corner.y, corner.x);
-		raytraceAngle = raytraceAngle < 0 ? raytraceAngle + 2 * PI : raytraceAngle;
-		raytraceAngle = raytraceAngle * 360.f / (2 * PI);
-		int raytraceIndex = std::floor(raytraceAngle / (360.f / SECTORSIZE));
-
-		vec2 hitPos = { rayTrace.x_t, rayTrace.y_t };
-
-		for (EntityLines& entityLine : entityLinesByAngles[raytraceIndex])
+		// Stop the ray at the nearest light blocking line
+		if (useSweep)
+		{
+			rayTrace.x_t = sweepHits[pointIndex].x;
+			rayTrace.y_t = sweepHits[pointIndex].y;
+		}
+		else
 		{
-			for (ParametricLine lightEq : entityLine.lightCollisionLines)
+			int occluderCount;
+			const int* occluders = m_occluderBins.GetItems(m_occluderBins.SectorOf(corner), occluderCount);
+
+			float hitTime;
+			if (m_occluderBatch.Raycast(rayTrace, 1.f, occluders, occluderCount, hitTime) != -1)
 			{
-				vec2 collisionLocation;
-				if (colManager.LinesCollide(rayTrace, lightEq, collisionLocation))
-				{
-					if (collisionLocation.Magnitude() < hitPos.Magnitude())
-					{
-						hitPos = collisionLocation;
-					}
-				}
+				rayTrace.x_t *= hitTime;
+				rayTrace.y_t *= hitTime;
 			}
 		}
 
-		rayTrace.x_t = hitPos.x;
-		rayTrace.y_t = hitPos.y;
+		const vec2 hitPos = { rayTrace.x_t, rayTrace.y_t };
 
-		for (EntityLines& entityLine : entityLinesByAngles[raytraceIndex])
+		int entityCount;
+		const int* entityIndices = m_entityBins.GetItems(m_entityBins.SectorOf(corner), entityCount);
+		for (int i = 0; i < entityCount; i++)
 		{
-			for (ParametricLine boundLine : entityLine.boundaryLines)
+			// Any of its lines up to where the ray stops lights the entity up
+			const int entityIndex = entityIndices[i];
+			float boundaryTime;
+			if (m_boundaryBatch.RaycastRange(rayTrace, 1.f, boundaryStarts[entityIndex], boundaryStarts[entityIndex + 1], boundaryTime) != -1)
 			{
-				vec2 collisionLocation;
-				if (colManager.LinesCollide(rayTrace, boundLine, collisionLocation))
-				{
-					entityLine.entity->set_lit(true);
-				}
+				m_litEntities.push_back(snapshot.GetItem(entities[entityIndex]).entity);
 			}
 		}
 
 		polyVertices.push_back(hitPos);
 	}
 
-	// Now create the actual 3d vertex and send to openGL
+	// Now create the actual 3d vertex, UploadPolygon sends them to openGL
 	const float depth = -0.02f;
-	std::vector<Vertex> vertices;
-	std::vector<uint16_t> indices;
+	std::vector<Vertex>& vertices = m_vertices;
+	std::vector<uint32_t>& indices = m_indices;
+	vertices.clear();
+	indices.clear();
 	Vertex vertex;
 	vertex.color = { 1.f, 1.f, 1.f };
 
@@ -310,56 +405,34 @@ void RadiusLightMesh::UpdateVertices()
 		indices.push_back(count); // currently added vertex
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
-
-	indicesToDraw = indices.size();
+	// Lighting entities up may change them (e.g. a lit texture of another size), in which case the stamp
+	// kept here no longer matches and the polygon is rebuilt next frame
+	std::sort(m_litEntities.begin(), m_litEntities.end());
+	m_litEntities.erase(std::unique(m_litEntities.begin(), m_litEntities.end()), m_litEntities.end());
+	m_hasPolygon = true;
+	m_polygonPosition = m_parent.m_position;
+	m_polygonRadius = m_lightRadius;
+	m_polygonInputStamp = inputStamp;
+	m_polygonAlgorithm = polygonAlgorithm;
 
 //	stopTiming("Polygon");
 }
 
 
-void RadiusLightMesh::DetermineLineSectors(ParametricLine line, std::set<int>& indexesToAdd)
+void RadiusLightMesh::PrintBinStats() const
 {
-	float angleFrom = std::atan2(-line.y_0, line.x_0);
-	angleFrom = angleFrom < 0 ? angleFrom + 2*PI : angleFrom;
-	float angleTo = std::atan2(-(line.y_0 + line.y_t), line.x_0 + line.x_t);
-	angleTo = angleTo < 0 ? angleTo + 2*PI : angleTo;
-
-	if (angleFrom > angleTo)
-	{
-		float temp = angleTo;
-		angleTo = angleFrom;
-		angleFrom = temp;
-	}
-
-	// Angle from is always smaller than angle to
-	float angleToDeg = angleTo * 360.f / (2 * PI);
-	float angleFromDeg = angleFrom * 360.f / (2 * PI);
-	int angleFromIndex = std::floor(angleFromDeg / (360.f / SECTORSIZE));
-	int angleToIndex = std::floor(angleToDeg / (360.f / SECTORSIZE));
-
-	if (angleToIndex == angleFromIndex)
+	auto printStats = [](const char* name, const AngularBins::Stats& stats)
 	{
-		indexesToAdd.insert(angleToIndex);
-		return;
-	}
+		std::cout << "  " << name << ": " << stats.itemCount << " in " << stats.sectorCount << " sectors, "
+			<< stats.entryCount << " entries, " << stats.maxEntries << " in the fullest, " << stats.emptySectors << " empty" << std::endl;
+	};
 
-	int direction = angleToIndex - angleFromIndex > (SECTORSIZE / 2) ? -1 : +1;
-	int i = angleFromIndex;
-	while(true)
+	std::cout << "Light at (" << m_parent.m_position.x << ", " << m_parent.m_position.y << ")" << std::endl;
+	if (m_polygonAlgorithm == PolygonAlgorithm::RayCast)
 	{
-		indexesToAdd.insert(i);
-
-		if (i == angleToIndex)
-		{
-			return;
-		}
-
-		i = (i + direction) % SECTORSIZE >= 0 ? (i + direction) % SECTORSIZE : (i + direction) % SECTORSIZE + SECTORSIZE;
+		printStats("occluders", m_occluderBins.GetStats());
 	}
+	printStats("entities", m_entityBins.GetStats());
 }
 
 vec2 RadiusLightMesh::get_position() const
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "common.hpp"
-#include <set>
+#include "VisibilitySweep.hpp"
+#include "GeometryStream.hpp"
+#include "AngularBins.hpp"
+#include "SegmentBatch.hpp"
 
 class World;
+class Entity;
 
 class RadiusLightMesh : public Renderable
 {
@@ -13,6 +17,13 @@ public:
 		vec2 m_position;
 	};
 
+	// How the light polygon is built. Both give the same polygon
+	enum class PolygonAlgorithm
+	{
+		RayCast,		// Each ray is tested against the light blocking lines of its sector
+		AngularSweep,	// Every ray at once, with VisibilitySweep
+	};
+
 public:
 	// Creates all the associated render resources and default transform
 	bool init();
@@ -22,7 +33,15 @@ public:
 
 	// Renders the player
 	void draw(const mat3& projection) override;
-	void predraw();
+
+	// Rebuilds the polygon on the CPU. Touches neither GL nor any entity, so lights can be computed on several threads at once
+	void ComputePolygon();
+
+	// Lights up the entities the polygon built by ComputePolygon reaches. Part of the update, not of drawing
+	void LightUpEntities();
+
+	// Writes the polygon built by ComputePolygon to this frame's GeometryStream, for draw. Has to be called on the GL thread
+	void UploadPolygon();
 
 	void SetParentData(ParentData data) { m_parent = data; }
 
@@ -34,12 +53,14 @@ public:
 		m_enablePolygon = !m_enablePolygon;
 	};
 
-private:
-	// Recreate polygonial mesh based on objects that block light around us. Happens per frame.
-	void UpdateVertices();
+	// Switches the algorithm used by every radius light, so that they can be compared while playing
+	static void TogglePolygonAlgorithm();
+	static PolygonAlgorithm GetPolygonAlgorithm() { return polygonAlgorithm; }
 
-	void DetermineLineSectors(ParametricLine line, std::set<int>& indexesToAdd);
+	// Prints how full the sectors of the last computed polygon were, to tune AngularBins
+	void PrintBinStats() const;
 
+private:
 	int indicesToDraw = 0;
 
 	// Data from the parent object (only player for now, but maybe lanterns too in future)
@@ -49,4 +70,39 @@ private:
 	float m_lightRadius;
 
 	bool m_enablePolygon = false;
+
+	VisibilitySweep m_visibilitySweep;
+
+	// Sectors of the ray cast algorithm, kept so that their storage is reused from one polygon to the next
+	AngularBins m_occluderBins;
+	AngularBins m_entityBins;
+	SegmentBatch m_occluderBatch;
+	SegmentBatch m_boundaryBatch;
+
+	// Lines and snapshot items gathered by ComputePolygon, kept so that their storage is reused too
+	std::vector<int> m_snapshotItems;
+	std::vector<int> m_entityItems;
+	ParametricLines m_occluderLines;
+	ParametricLines m_boundaryLines;
+	std::vector<int> m_boundaryStarts;
+
+	// Inputs of the polygon currently in our buffers, it is only rebuilt when one of them changes
+	bool m_hasPolygon = false;
+	vec2 m_polygonPosition;
+	float m_polygonRadius;
+	uint64_t m_polygonInputStamp;
+	PolygonAlgorithm m_polygonAlgorithm;
+
+	// Entities the polygon lights up. Lit state is reset every frame, so they are lit again whenever the polygon is reused
+	std::vector<Entity*> m_litEntities;
+
+	// Built by ComputePolygon, written to the GeometryStream by UploadPolygon
+	std::vector<Vertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+
+	// Where UploadPolygon wrote them this frame
+	GeometryStream::Allocation m_vertexAllocation;
+	GeometryStream::Allocation m_indexAllocation;
+
+	static PolygonAlgorithm polygonAlgorithm;
 };
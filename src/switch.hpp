@@ -17,6 +17,7 @@ public:
 	}
 	const char* get_audio_path() const override { return audio_path("switch_sound.wav"); }
 	bool is_light_dynamic() const override { return true; }
+	bool lit_changes_gameplay() const override { return true; }
 
 	bool init(float x_pos, float y_pos) override;
 
@@ -4,7 +4,7 @@ ParametricLines Wall::calculate_dynamic_equations() const
 {
 	ParametricLines outLines;
 
-	if (!is_light_collidable()) {
+	if (!is_light_collidable() || outlineMerged) {
 		return outLines;
 	}
 
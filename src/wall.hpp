@@ -15,11 +15,15 @@ public:
 private:
 	NeighborIsWall neighbors;
 
+	// Set when the level merged this wall's edges into longer outline segments (see CollisionManager::RegisterStaticOutline)
+	bool outlineMerged = false;
+
 public:
 	const char* get_texture_path() const override { return textures_path("wall.png"); }
 	const char* get_lit_texture_path() const override { return textures_path("wall.png"); }
 	bool is_player_collidable() const override { return true; }
 	bool is_light_collidable() const override { return true; }
+	bool is_static_tile() const override { return true; }
 	virtual bool no_neighboring_walls() const { return true; }
 	virtual bool is_light_dynamic() const override { return no_neighboring_walls(); }
 
@@ -27,4 +31,5 @@ public:
 	ParametricLines calculate_dynamic_equations() const override;
 
 	NeighborIsWall& GetNeighborStruct() { return neighbors; };
+	void SetOutlineMerged(bool merged) { outlineMerged = merged; };
 };
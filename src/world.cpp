@@ -1,11 +1,21 @@
 // Header
 #include "world.hpp"
 #include "CollisionManager.hpp"
+#include "GeometryStream.hpp"
+#include "ShaderCache.hpp"
+#include "TextureCache.hpp"
+#include "SpriteBatch.hpp"
+#include "StaticTileChunks.hpp"
 #include "door.hpp"
 #include "switch.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 const float NEXT_LEVEL_DELAY = 450.f;
 const float SCREEN_SCALE = 1.2f;
+// Lights are kept up to date this far out of view, so that what comes into view is already lit
+const float LIGHT_VIEW_MARGIN = BLOCK_SIZE * 4;
 #define LASER_UNLOCK 12
 
 // Same as static in c, local to compilation unit
@@ -56,6 +66,14 @@ bool World::init(vec2 screen) {
 	// Load OpenGL function pointers
 	gl3w_init();
 
+	// Per frame light geometry
+	if (!GeometryStream::GetInstance().Init())
+		return false;
+
+	// Entity sprites, drawn a texture at a time
+	if (!SpriteBatch::GetInstance().Init())
+		return false;
+
 	// Setting callbacks to member functions (that's why the redirect is needed)
 	// Input is handled using GLFW, for more info see
 	// http://www.glfw.org/docs/latest/input_guide.html
@@ -118,7 +136,7 @@ bool World::init(vec2 screen) {
 		std::cout << "Loaded save state from file.\n" << std::endl;
 	}
 
-	levelGenerator.create_current_level(m_save_state.current_level, m_player, m_entities);
+	create_level();
 
 	for (int i = 0; i < MAX_LEVEL; ++i) {
 		m_unlocked_level_sparkles.push_back(UnlockedLevelSparkle());
@@ -143,6 +161,7 @@ bool World::init(vec2 screen) {
 void World::destroy()
 {
 	glDeleteFramebuffers(1, &m_frame_buffer);
+	GeometryStream::GetInstance().Destroy();
 
 	if (m_background_music != nullptr) {
 		Mix_FreeMusic(m_background_music);
@@ -172,6 +191,10 @@ void World::destroy()
 	for (int i = 0; i < m_unlocked_level_sparkles.size(); ++i) {
 		m_unlocked_level_sparkles[i].destroy();
 	}
+	m_static_tiles.Destroy();
+	SpriteBatch::GetInstance().Destroy();
+	ShaderCache::GetInstance().Destroy();
+	TextureCache::GetInstance().Destroy();
 	glfwDestroyWindow(m_window);
 }
 
@@ -191,30 +214,51 @@ bool World::update(float elapsed_ms) {
 			m_display_laser_screen_elapsed = 250.f;
 		}
 		// First move the world (entities)
+		m_tracing_fireflies.clear();
+		m_trace_requests.clear();
 		for (auto entity : m_entities) {
 			entity->update(elapsed_ms);
-			// If one of our entities is a door, check for player collision
-			if (Door* door = dynamic_cast<Door*>(entity)) {
-				m_w_position = door->get_position();
-				if (door->is_enterable() && door->is_player_inside(&m_player)) {
-						if (m_interact) {
-							if (m_save_state.skips_allowed < MAX_SKIPS &&
-							m_save_state.current_level != door->get_level_index() &&
-							m_save_state.unlocked_levels > m_save_state.current_level) {
-								m_save_state.skips_allowed++;
-							}
-							m_save_state.current_level = door->get_level_index();
-							next_level();
-							m_current_level_top_menu.update(m_save_state.current_level);
-							return true;
-						}
-						else {
-							float offset = m_press_w.update();
-							m_press_w.set_position({ m_w_position.x, (m_w_position.y + offset) });
-							m_draw_w = true;
-						}
+			// Fireflies only decide where they want to go, their moves are traced all together below
+			if (Firefly* firefly = dynamic_cast<Firefly*>(entity)) {
+				CollisionManager::TraceRequest request;
+				if (firefly->get_trace_request(request)) {
+					m_tracing_fireflies.push_back(firefly);
+					m_trace_requests.push_back(request);
+				}
+			}
+		}
+		// Then check whether the player is at a door, through the triggers they overlap
+		CollisionManager::GetInstance().GetPlayerTriggers(m_player_triggers);
+		for (Entity* trigger : m_player_triggers) {
+			Door* door = dynamic_cast<Door*>(trigger);
+			if (door == nullptr || !door->is_enterable()) {
+				continue;
+			}
+			m_w_position = door->get_position();
+			if (m_interact) {
+				if (m_save_state.skips_allowed < MAX_SKIPS &&
+				m_save_state.current_level != door->get_level_index() &&
+				m_save_state.unlocked_levels > m_save_state.current_level) {
+					m_save_state.skips_allowed++;
 				}
+				m_save_state.current_level = door->get_level_index();
+				next_level();
+				m_current_level_top_menu.update(m_save_state.current_level);
+				return true;
 			}
+			else {
+				float offset = m_press_w.update();
+				m_press_w.set_position({ m_w_position.x, (m_w_position.y + offset) });
+				m_draw_w = true;
+			}
+		}
+		// Then push the player out of the way of the platforms that moved
+		CollisionManager::GetInstance().ResolveKinematicBodies();
+		// Then move the fireflies
+		m_trace_results.resize(m_trace_requests.size());
+		CollisionManager::GetInstance().BoxTraceBatch(m_trace_requests.data(), (int)m_trace_requests.size(), m_trace_results.data());
+		for (size_t i = 0; i < m_tracing_fireflies.size(); i++) {
+			m_tracing_fireflies[i]->apply_trace_result(m_trace_results[i]);
 		}
 		for (Entity* entity : m_entities)
 		{
@@ -237,6 +281,9 @@ bool World::update(float elapsed_ms) {
 				}
 			}
 		}
+
+		// Last, once everything has moved. Entities see what they were lit by on their next update
+		update_lights();
 	}
 
 	m_screen.update(elapsed_ms);
@@ -289,15 +336,72 @@ void World::draw() {
 
 	mat3 projection_2D = draw_projection_matrix(w, h, retinaScale, m_player.get_position());
 
+	// Same view as the projection, update_lights uses the last one too
+	const vec2 viewPosition = m_player.get_position();
+	m_view_half_bound = { w * SCREEN_SCALE / retinaScale / 2, h * SCREEN_SCALE / retinaScale / 2 };
+
 	vec3 colour = vec3({ 1.0,0.0,0.0 });
 
+	// Light polygons were computed by update, they only need to be in this frame's stream
+	GeometryStream::GetInstance().BeginFrame();
+	for (RadiusLightMesh* lightMesh : m_light_meshes) {
+		lightMesh->UploadPolygon();
+	}
+	if (m_laser_mesh != nullptr) {
+		m_laser_mesh->UploadPolygon();
+	}
+
+	// Only entities whose drawing reaches the view are drawn. The grid gives everything registered that could,
+	// each of them then checks with how far past its box it draws. Unregistered ones only have their position and reach
+	const vec2 candidateHalfBound = m_view_half_bound + vec2({ m_max_draw_reach, m_max_draw_reach });
+	CollisionManager& collisionManager = CollisionManager::GetInstance();
+	collisionManager.GetEntitiesInBox(viewPosition, candidateHalfBound, m_visible_entities);
+	auto isVisible = [&](Entity* entity) {
+		if (entity->alwaysRender()) {
+			return true;
+		}
+		const bool registered = collisionManager.IsRegistered(entity);
+		if (registered && !std::binary_search(m_visible_entities.begin(), m_visible_entities.end(), entity)) {
+			return false;
+		}
+		const vec2 position = entity->get_position();
+		const vec2 bound = registered ? entity->get_bounding_box() : vec2({ 0.f, 0.f });
+		const float reach = entity->get_draw_reach();
+		return std::fabs(position.x - viewPosition.x) < m_view_half_bound.x + bound.x / 2 + reach &&
+			std::fabs(position.y - viewPosition.y) < m_view_half_bound.y + bound.y / 2 + reach;
+	};
+
+	// Kept in the order of m_entities, which is the drawing order
+	m_draw_entities.clear();
 	for (Entity* entity : m_entities) {
+		if (isVisible(entity)) {
+			m_draw_entities.push_back(entity);
+		}
+	}
+
+	for (Entity* entity : m_draw_entities) {
 		entity->predraw();
 	}
 
-	for (Entity* entity: m_entities) {
+	// Entities queue their sprites, anything else they draw flushes them first. Static tiles are drawn from their
+	// chunks, a layer at a time where the tiles are in m_entities
+	SpriteBatch& spriteBatch = SpriteBatch::GetInstance();
+	spriteBatch.Begin(projection_2D);
+	int drawnLayers = 0;
+	for (Entity* entity: m_draw_entities) {
+		if (entity->is_static_tile()) {
+			continue;
+		}
+		const int layersBefore = m_static_tiles.GetLayersBefore(entity);
+		if (layersBefore > drawnLayers) {
+			spriteBatch.Flush();
+			m_static_tiles.Draw(projection_2D, viewPosition, m_view_half_bound, drawnLayers, layersBefore);
+			drawnLayers = layersBefore;
+		}
 		entity->draw(projection_2D);
 	}
+	spriteBatch.Flush();
+	m_static_tiles.Draw(projection_2D, viewPosition, m_view_half_bound, drawnLayers, m_static_tiles.GetLayerCount());
 	m_player.draw(projection_2D);
 
 	float scaled_width = w / SCREEN_SCALE;
@@ -364,11 +468,72 @@ void World::draw() {
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, m_screen_tex.id);
 	m_screen.draw(projection_2D);
+	GeometryStream::GetInstance().EndFrame();
 	//////////////////
 	// Presenting
 	glfwSwapBuffers(m_window);
 }
 
+void World::create_level() {
+	levelGenerator.create_current_level(m_save_state.current_level, m_player, m_entities);
+	m_static_tiles.Build(m_entities);
+
+	// How far around the view draw has to look for entities, set by those drawing furthest past their box
+	m_max_draw_reach = 0.f;
+	for (Entity* entity : m_entities) {
+		m_max_draw_reach = std::max(m_max_draw_reach, entity->get_draw_reach());
+	}
+}
+
+void World::update_lights() {
+	CollisionManager& collisionManager = CollisionManager::GetInstance();
+	collisionManager.UpdateLightSnapshot();
+
+	// Where the last frame was drawn, around where the player is now, and the margin.
+	// Nothing is in view before the first draw (e.g. without a window)
+	const vec2 viewPosition = m_player.get_position();
+	const vec2 viewHalfBound = m_view_half_bound.x > 0.f ? m_view_half_bound + vec2({ LIGHT_VIEW_MARGIN, LIGHT_VIEW_MARGIN }) : vec2({ 0.f, 0.f });
+
+	// Lights that reach neither the view nor anything that reacts to being lit are not computed at all
+	m_light_meshes.clear();
+	for (Entity* entity : m_entities) {
+		RadiusLightMesh* lightMesh = entity->prepare_light();
+		if (lightMesh == nullptr) {
+			continue;
+		}
+
+		const vec2 lightPosition = lightMesh->get_position();
+		const float reach = lightMesh->getLightRadius();
+		const bool reachesView = viewHalfBound.x > 0.f &&
+			std::fabs(lightPosition.x - viewPosition.x) < viewHalfBound.x + reach &&
+			std::fabs(lightPosition.y - viewPosition.y) < viewHalfBound.y + reach;
+		if (reachesView || collisionManager.HasEntityInRange(lightPosition, reach, AabbStore::LIGHT_SENSITIVE)) {
+			m_light_meshes.push_back(lightMesh);
+		}
+	}
+	if (RadiusLightMesh* lightMesh = m_player.prepare_light()) {
+		m_light_meshes.push_back(lightMesh);
+	}
+
+	// Polygons only read the collision manager's snapshot, so every light can be computed at once
+	m_worker_pool.ParallelFor((int)m_light_meshes.size(), [this](int i) {
+		m_light_meshes[i]->ComputePolygon();
+	});
+
+	m_laser_mesh = m_player.prepare_laser();
+	if (m_laser_mesh != nullptr) {
+		m_laser_mesh->ComputePolygon();
+	}
+
+	// Lighting entities up may change the snapshot (e.g. a lit texture of another size), so it is only done once every polygon is built
+	for (RadiusLightMesh* lightMesh : m_light_meshes) {
+		lightMesh->LightUpEntities();
+	}
+	if (m_laser_mesh != nullptr) {
+		m_laser_mesh->LightUpEntities();
+	}
+}
+
 // Should the game be over ?
 bool World::is_over()const
 {
@@ -379,6 +544,10 @@ void World::reset_game() {
 	int w, h;
 	glfwGetWindowSize(m_window, &w, &h);
 
+	// They belong to the entities about to be deleted, the next update computes the new level's
+	m_light_meshes.clear();
+	m_laser_mesh = nullptr;
+
 	for (Entity* entity : m_entities) {
 		delete entity;
 	}
@@ -386,7 +555,7 @@ void World::reset_game() {
 
 	m_player.destroy();
 	m_press_w.destroy();
-	levelGenerator.create_current_level(m_save_state.current_level, m_player, m_entities);
+	create_level();
 	m_player.init();
 	m_press_w.init(m_screen_size);
 
@@ -464,6 +633,18 @@ void World::on_key(GLFWwindow* window, int key, int, int action, int mod)
 		else if (key == GLFW_KEY_L) {
 			m_player.toggleShowPolygon();
 		}
+		else if (key == GLFW_KEY_V) {
+			RadiusLightMesh::TogglePolygonAlgorithm();
+		}
+		else if (key == GLFW_KEY_B) {
+			for (const RadiusLightMesh* lightMesh : m_light_meshes) {
+				lightMesh->PrintBinStats();
+			}
+			const TextureCache::Stats& textures = TextureCache::GetInstance().GetStats();
+			std::cout << "Textures: " << textures.textureCount << " loaded (" << textures.residentBytes << " bytes), "
+				<< textures.unborrowedCount << " unborrowed (" << textures.unborrowedBytes << " bytes), "
+				<< textures.hits << " hits, " << textures.misses << " misses" << std::endl;
+		}
 		else if (key == GLFW_KEY_P) {
 			// Disable level selection when launch screen is open
 			if (!m_should_game_start_screen) {
@@ -4,6 +4,7 @@
 #include "common.hpp"
 #include "player.hpp"
 #include "entity.hpp"
+#include "firefly.hpp"
 #include "screen.hpp"
 #include "game-screens/level_screen.hpp"
 #include "pause_screen.hpp"
@@ -18,6 +19,8 @@
 #include "LevelGenerator.hpp"
 #include "press_w.hpp"
 #include "TextRenderer.hpp"
+#include "WorkerPool.hpp"
+#include "StaticTileChunks.hpp"
 
 // stlib
 #include <vector>
@@ -108,6 +111,12 @@ public:
 private:
 	void reset_game();
 
+	// Creates the entities of the current level, and what is kept about them for drawing
+	void create_level();
+
+	// Decides what every light reaches and lights it up. Only reads the collision manager, no GL, so update runs without drawing
+	void update_lights();
+
 	void load_level_screen(int key_pressed_level);
 
 	// !!! INPUT CALLBACK FUNCTIONS
@@ -151,6 +160,29 @@ private:
 	std::vector<Entity*> m_entities;
 	Mix_Music* m_background_music;
 
+	// Fireflies moving this frame, traced together once every entity has updated
+	std::vector<Firefly*> m_tracing_fireflies;
+	std::vector<CollisionManager::TraceRequest> m_trace_requests;
+	std::vector<CollisionManager::CollisionResult> m_trace_results;
+
+	// Triggers the player overlaps this frame
+	std::vector<Entity*> m_player_triggers;
+
+	// Light polygons are computed on the pool by update, draw only uploads them
+	WorkerPool m_worker_pool;
+	std::vector<RadiusLightMesh*> m_light_meshes;
+	LaserLightMesh* m_laser_mesh = nullptr;
+
+	// Meshes of the level's static tiles, rebuilt with every level
+	StaticTileChunks m_static_tiles;
+
+	// Culling. Half the size of the last drawn view, how far past its box an entity of the level draws at most,
+	// the registered entities that may be in view this frame and the entities drawn this frame
+	vec2 m_view_half_bound = { 0.f, 0.f };
+	float m_max_draw_reach = 0.f;
+	std::vector<Entity*> m_visible_entities;
+	std::vector<Entity*> m_draw_entities;
+
 	// C++ rng
 	std::default_random_engine m_rng;
 	std::uniform_real_distribution<float> m_dist; // default 0..1
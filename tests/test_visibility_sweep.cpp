@@ -0,0 +1,121 @@
+// Checks VisibilitySweep against casting every ray at every segment, on segments that share endpoints.
+// Exits with 1 if a hit differs
+#include <cmath>
+#include <iostream>
+#include "VisibilitySweep.hpp"
+
+namespace
+{
+	const float TOLERANCE = 0.01f;
+	const int RAY_COUNT = 720;
+	const float RAY_LENGTH = 400.f;
+
+	float Cross(vec2 a, vec2 b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+
+	ParametricLine Segment(vec2 start, vec2 end)
+	{
+		return { start.x, end.x - start.x, start.y, end.y - start.y };
+	}
+
+	// Where the ray from (0, 0) to point first hits a segment, every segment tested
+	vec2 CastRay(const ParametricLines& segments, vec2 point)
+	{
+		float nearest = 1.f;
+		for (const ParametricLine& line : segments)
+		{
+			const vec2 start = { line.x_0, line.y_0 };
+			const vec2 delta = { line.x_t, line.y_t };
+			const float denominator = Cross(point, delta);
+			if (denominator == 0.f)
+			{
+				continue;
+			}
+
+			const float time = Cross(start, delta) / denominator;
+			const float along = Cross(start, point) / denominator;
+			if (time >= 0.f && along >= 0.f && along <= 1.f)
+			{
+				nearest = std::fmin(nearest, time);
+			}
+		}
+		return point * nearest;
+	}
+
+	// Rays all around, plus one through every endpoint
+	std::vector<vec2> Rays(const ParametricLines& segments)
+	{
+		std::vector<vec2> points;
+		for (int i = 0; i < RAY_COUNT; i++)
+		{
+			const float angle = 2.f * 3.14159265f * i / RAY_COUNT;
+			points.push_back({ RAY_LENGTH * std::cos(angle), RAY_LENGTH * std::sin(angle) });
+		}
+		for (const ParametricLine& line : segments)
+		{
+			points.push_back(vec2({ line.x_0, line.y_0 }) * 2.f);
+			points.push_back(vec2({ line.x_0 + line.x_t, line.y_0 + line.y_t }) * 2.f);
+		}
+		return points;
+	}
+
+	bool Check(const char* name, const ParametricLines& segments)
+	{
+		const std::vector<vec2> points = Rays(segments);
+		std::vector<vec2> hits;
+		VisibilitySweep sweep;
+		sweep.Compute(segments, points, hits);
+
+		int failures = 0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			const vec2 expected = CastRay(segments, points[i]);
+			if (std::fabs(hits[i].x - expected.x) > TOLERANCE || std::fabs(hits[i].y - expected.y) > TOLERANCE)
+			{
+				if (failures++ < 5)
+				{
+					std::cout << name << ": ray to (" << points[i].x << ", " << points[i].y << ") hit (" << hits[i].x << ", " << hits[i].y
+						<< "), expected (" << expected.x << ", " << expected.y << ")" << std::endl;
+				}
+			}
+		}
+		std::cout << name << ": " << (failures == 0 ? "ok" : "FAILED") << std::endl;
+		return failures == 0;
+	}
+}
+
+int main()
+{
+	bool passed = true;
+
+	// Two edges of a wall meeting at a corner, the sweep ray passes right through the corner
+	passed &= Check("corner", { Segment({ 100.f, -50.f }, { 100.f, 50.f }), Segment({ 100.f, 50.f }, { 0.f, 50.f }) });
+
+	// Two segments from one endpoint, one behind the other on one side: which is in front swaps at the shared endpoint
+	passed &= Check("shared endpoint", { Segment({ 80.f, 0.f }, { 120.f, 60.f }), Segment({ 80.f, 0.f }, { 200.f, 30.f }) });
+
+	// The same, meeting at the far end instead
+	passed &= Check("shared far endpoint", { Segment({ 60.f, 20.f }, { 150.f, 90.f }), Segment({ 120.f, -40.f }, { 150.f, 90.f }) });
+
+	// A closed box outline around the angle 0, where segments are already under the sweep ray when it starts
+	passed &= Check("box across angle 0", {
+		Segment({ 100.f, -50.f }, { 100.f, 50.f }), Segment({ 100.f, 50.f }, { 200.f, 50.f }),
+		Segment({ 200.f, 50.f }, { 200.f, -50.f }), Segment({ 200.f, -50.f }, { 100.f, -50.f }) });
+
+	// A row of touching tiles, every inner corner shared by four edges
+	ParametricLines tiles;
+	for (int tile = 0; tile < 4; tile++)
+	{
+		const float left = -100.f + tile * 50.f;
+		const float right = left + 50.f;
+		tiles.push_back(Segment({ left, 60.f }, { right, 60.f }));
+		tiles.push_back(Segment({ right, 60.f }, { right, 110.f }));
+		tiles.push_back(Segment({ right, 110.f }, { left, 110.f }));
+		tiles.push_back(Segment({ left, 110.f }, { left, 60.f }));
+	}
+	passed &= Check("tile row", tiles);
+
+	return passed ? 0 : 1;
+}